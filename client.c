@@ -1,12 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "relic/relic.h"
 /* Internal includes */
 #include "core/send/send.h"
+#include "core/send/pool.h"
+#include "core/send/pipeline.h"
+#include "core/send/uring.h"
+#include "core/send/hedge.h"
+#include "core/send/load.h"
 #include "core/request/json.h"
 #include "core/message/message.h"
+#include "core/message/message_pool.h"
 #include "core/request/request.h"
+#include "core/request/batch.h"
+#include "core/request/binary.h"
+#include "core/request/compare.h"
 #include "core/crypto/mklhs/mklhs.h"
+#include "core/crypto/mklhs/sign_pool.h"
+#include "core/crypto/mklhs/signer.h"
+#include "core/crypto/mklhs/presign.h"
+#include "core/crypto/mklhs/key_manager.h"
+#include "core/crypto/mklhs/verifier.h"
+#include "core/crypto/keystore/keystore.h"
+#include "core/crypto/curve/curve.h"
+#include "core/crypto/curve/bench.h"
 #include "core/utils/base64.h"
 #include "core/utils/utils.h"
 
@@ -14,25 +33,413 @@
 #include "testing/testing.h"
 #endif
 
+/* How messages are signed */
+typedef struct signing
+{
+  key_manager_t *keys;      /* Current key, its tables and encoded public key */
+  sign_pool_t *pool;        /* Signing threads, NULL to sign on the calling thread */
+  presign_t *presign;       /* Precomputed tags, NULL to hash every tag online */
+  verifier_t *verifier;     /* Checks a sample of the signatures, NULL for none */
+  message_pool_t *messages; /* Messages and signature buffers reused across batches */
+  request_template_t *request; /* Constant fields of JSON requests for the current key */
+} signing_t;
+
+static void signing_free(signing_t *signing)
+{
+  if (signing->verifier != NULL)
+  {
+    verifier_report(signing->verifier, stdout);
+    verifier_destroy(signing->verifier);
+  }
+  if (signing->presign != NULL)
+    presign_destroy(signing->presign);
+  if (signing->pool != NULL)
+    sign_pool_destroy(signing->pool);
+  request_template_free(signing->request);
+  message_pool_destroy(signing->messages);
+  key_manager_destroy(signing->keys);
+}
+
+/* Generate, sign and serialize one batch of data points into json, in the binary encoding if
+   binary is set, or add it to a batch request */
+static int build_batch(json_t *json, batch_t *messages, const signing_t *signing, uint64_t scale,
+                       int binary)
+{
+  mklhs_key_t *key = signing->keys->current;
+#ifdef TEST_MODE
+  struct timeval start_init = timer_start();
+#endif
+  /* Take a message whose RELIC objects and signature buffers are already allocated */
+  message_slot_t *slot = message_pool_acquire(signing->messages);
+  if (slot == NULL)
+  {
+    fprintf(stderr, "No free message in the pool\n");
+    return -1;
+  }
+  message_t *message = &slot->message;
+  dig_t *data_points = slot->data_points;
+  size_t num_data_points = signing->messages->num_data_points;
+  int res = -1;
+  /* Generate data points based on arguments */
+  int gen_res = gen_dig_data_points(data_points, num_data_points);
+  if (gen_res != 0)
+  {
+    fprintf(stderr, "Failed to generate data points\n");
+    goto release;
+  }
+  /* Reset the message */
+  int init_res = reset_message(message, data_points, num_data_points);
+  if (init_res != 0)
+  {
+    fprintf(stderr, "Failed to initialize message\n");
+    goto release;
+  }
+#ifdef TEST_MODE
+  timer_end(start_init, "init");
+  struct timeval start_sign = timer_start();
+#endif
+  /* Sign the data points with the key's tables, online only the value-dependent
+     part if tags were precomputed, else split across the signing threads if there are any */
+  int sign_res;
+  if (signing->presign != NULL)
+    sign_res = presign_sign_points(signing->presign, message, num_data_points);
+  else
+    sign_res = sign_pool_sign(signing->pool, message, key->sk, &key->signer, num_data_points);
+  if (sign_res != 0)
+  {
+    fprintf(stderr, "Failed to sign data points\n");
+    goto release;
+  }
+#ifdef TEST_MODE
+  timer_end(start_sign, "sign");
+#endif
+  /* Only the verifier needs the base64 strings on their own. Otherwise the binary encoding
+     sends the raw signatures and JSON encodes the points in place (json_add_g1()) */
+  char **master_decoded_sig_buf = NULL;
+#ifdef TEST_MODE
+  struct timeval start_encode = timer_start();
+#endif
+  int encode_res;
+  if (signing->verifier != NULL)
+  {
+    master_decoded_sig_buf = slot->master_decoded;
+    encode_res = encode_signatures_into(message, slot->master,
+                                        master_decoded_sig_buf, num_data_points);
+  }
+  else if (binary)
+  {
+    encode_res = write_signatures(message, slot->master, num_data_points) < 0;
+  }
+  else
+  {
+    encode_res = normalize_signatures(message, num_data_points);
+  }
+  if (encode_res != 0)
+  {
+    fprintf(stderr, "Failed to encode signatures\n");
+    goto release;
+  }
+  /* Check a sample of what goes on the wire in the background */
+  if (signing->verifier != NULL)
+    verifier_offer(signing->verifier, message, master_decoded_sig_buf, num_data_points, key->pk);
+  /* The signatures are normalized now, so this does not invert again */
+  int sig_len = g1_size_bin(message->sigs[0], 1);
+#ifdef TEST_MODE
+  timer_end(start_encode, "encode");
+  struct timeval start_prepare = timer_start();
+#endif
+  /* Serialize the request */
+  int prepare_json;
+  if (messages != NULL)
+    prepare_json = batch_add(messages, message, master_decoded_sig_buf, data_points,
+                             num_data_points, sig_len) < 0;
+  else if (binary)
+    prepare_json = prepare_req_binary(json, message, slot->master, data_points, num_data_points,
+                                      key->pk_bin, key->pk_len, sig_len, scale, FUNC);
+  else if (!request_template_matches(signing->request, key->serial, sig_len, scale) &&
+           request_template_compile(signing->request, key->serial, message->id, TEST_DATABASE,
+                                    key->pk_b64, sig_len, scale, FUNC) != 0)
+    prepare_json = -1;
+  else
+    prepare_json = prepare_req_template(json, signing->request, message, master_decoded_sig_buf,
+                                        data_points, num_data_points);
+#ifdef TEST_MODE
+  timer_end(start_prepare, "prepare");
+#endif
+  if (prepare_json != 0)
+  {
+    fprintf(stderr, "Failed to prepare request\n");
+    goto release;
+  }
+  res = 0;
+
+release:
+  message_pool_release(signing->messages, slot);
+  return res;
+}
+
+/* Send requests at a fixed rate regardless of the responses and report corrected latencies */
+static int run_open_loop(const endpoint_t *endpoint, const char *path, double rate,
+                         load_arrival_t arrival, int requests, int messages_per_request,
+                         const signing_t *signing, int binary)
+{
+  /* Every body is signed with the current key, rotation only applies to the closed loop */
+  char *pk_b64 = signing->keys->current->pk_b64;
+  /* Sign a body per request up front so signing does not hold back the schedule. Past
+     LOAD_MAX_BODIES or LOAD_MAX_BODY_BYTES the bodies are replayed, load_report() says so */
+  int num_bodies = requests < LOAD_MAX_BODIES ? requests : LOAD_MAX_BODIES;
+  json_t *json = (json_t *)calloc(num_bodies, sizeof(json_t));
+  char **bodies = (char **)calloc(num_bodies, sizeof(char *));
+  size_t *lengths = (size_t *)calloc(num_bodies, sizeof(size_t));
+  size_t body_bytes = 0;
+  int built = 0;
+  int res = -1;
+  if (json == NULL || bodies == NULL || lengths == NULL)
+  {
+    fprintf(stderr, "Could not allocate request bodies\n");
+    goto cleanup;
+  }
+  for (; built < num_bodies && body_bytes < LOAD_MAX_BODY_BYTES; built++)
+  {
+    if (json_init_growable(&json[built], NULL, 0) != 0)
+      goto cleanup;
+    if (messages_per_request > 1)
+    {
+      batch_t batch;
+      if (batch_init(&batch, &json[built], messages_per_request, pk_b64, 1, FUNC) != 0)
+        goto cleanup_current;
+      for (int m = 0; m < messages_per_request; m++)
+      {
+        if (build_batch(NULL, &batch, signing, 1, 0) != 0)
+          goto cleanup_current;
+      }
+      if (batch_finish(&batch) != 0)
+        goto cleanup_current;
+    }
+    else if (build_batch(&json[built], NULL, signing, 1, binary) != 0)
+    {
+      goto cleanup_current;
+    }
+    bodies[built] = json[built].buffer;
+    lengths[built] = json[built].pos;
+    body_bytes += json[built].pos;
+  }
+
+  load_t load;
+  const char *content_type = binary ? BINARY_CONTENT_TYPE : JSON_CONTENT_TYPE;
+  if (load_init(&load, endpoint, path, content_type, LOAD_DEFAULT_CONNECTIONS, rate, arrival) != 0)
+  {
+    fprintf(stderr, "Failed to connect to server\n");
+    goto cleanup;
+  }
+  int answered = load_run(&load, bodies, lengths, built, requests);
+  if (answered >= 0)
+  {
+    load_report(&load, stdout);
+    res = answered == requests ? 0 : -1;
+  }
+  load_destroy(&load);
+  goto cleanup;
+
+cleanup_current:
+  json_free(&json[built]);
+cleanup:
+  for (int b = 0; b < built; b++)
+    json_free(&json[b]);
+  free(json);
+  free(bodies);
+  free(lengths);
+  return res;
+}
+
 /* MAIN */
 int main(int argc, char *argv[])
 {
   int iterations = 0;
   int iterations_count = 1000;
-  relic_init();
-  int sockfd = connect_to_server(SERVER_IP, SERVER_PORT);
-  if (sockfd < 0)
+  int window = PIPELINE_DEFAULT_WINDOW;
+  int use_uring = 0;
+  const char *server = SERVER_IP;
+  int hedge_percentile = 0;
+  int messages_per_request = NUM_MESSAGES;
+  double rate = 0;
+  load_arrival_t arrival = LOAD_FIXED;
+  int sign_threads = 1;
+  int use_presign = 0;
+  const char *keystore_path = NULL;
+  long rotate_messages = 0;
+  long rotate_seconds = 0;
+  const char *curve_name = NULL;
+  int bench = 0;
+  double verify_percent = 0;
+  int num_data_points = NUM_DATA_POINTS;
+  int binary = 0;
+  int compare = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:ue:H:m:r:pt:ok:R:T:c:Bv:n:bW")) != -1)
   {
-    printf("Failed to connect to server\n");
+    switch (opt)
+    {
+    case 'k':
+      keystore_path = optarg;
+      break;
+    case 'c':
+      curve_name = optarg;
+      break;
+    case 'B':
+      bench = 1;
+      break;
+    case 'v':
+      verify_percent = atof(optarg);
+      break;
+    case 'n':
+      num_data_points = atoi(optarg);
+      break;
+    case 'b':
+      binary = 1;
+      break;
+    case 'W':
+      compare = 1;
+      break;
+    case 'R':
+      rotate_messages = atol(optarg);
+      break;
+    case 'T':
+      rotate_seconds = atol(optarg);
+      break;
+    case 'o':
+      use_presign = 1;
+      break;
+    case 't':
+      sign_threads = atoi(optarg);
+      break;
+    case 'r':
+      rate = atof(optarg);
+      break;
+    case 'p':
+      arrival = LOAD_POISSON;
+      break;
+    case 'm':
+      messages_per_request = atoi(optarg);
+      break;
+    case 'H':
+      hedge_percentile = atoi(optarg);
+      break;
+    case 'e':
+      server = optarg;
+      break;
+    case 'w':
+      window = atoi(optarg);
+      break;
+    case 'u':
+      use_uring = 1;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-e ip[:port] | unix:/path/to.sock] [-w pipeline window] [-u] [-H hedge percentile] [-m messages per request] [-r open-loop rate [-p]] [-t signing threads] [-o] [-k keystore] [-R rotate after messages] [-T rotate after seconds] [-c curve] [-B] [-v verify percent] [-n data points per message] [-b] [-W]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (window < 1 || window > PIPELINE_MAX_WINDOW)
+  {
+    fprintf(stderr, "Pipeline window must be between 1 and %d\n", PIPELINE_MAX_WINDOW);
+    return -1;
+  }
+  if (messages_per_request < 1 || messages_per_request > BATCH_MAX_MESSAGES)
+  {
+    fprintf(stderr, "Messages per request must be between 1 and %d\n", BATCH_MAX_MESSAGES);
+    return -1;
+  }
+  if (num_data_points < 1 || num_data_points > MAX_DATA_POINTS)
+  {
+    fprintf(stderr, "Data points per message must be between 1 and %d\n", MAX_DATA_POINTS);
+    return -1;
+  }
+  if (binary && messages_per_request > 1)
+  {
+    fprintf(stderr, "The binary encoding carries one message per request\n");
+    return -1;
+  }
+  /* Several messages per request are sent as one batch envelope */
+  const char *path = messages_per_request > 1 ? BATCH_PATH : "/new";
+  endpoint_t endpoint;
+  if (endpoint_parse(&endpoint, server, SERVER_PORT) != 0)
+    return -1;
+  /* Every RELIC context of the process is set up with this curve */
+  if (curve_name != NULL)
+  {
+    const curve_info_t *curve = curve_find(curve_name);
+    if (curve == NULL)
+    {
+      fprintf(stderr, "Unknown curve %s\n", curve_name);
+      curve_print_list(stderr);
+      return -1;
+    }
+    curve_select(curve);
+  }
+  if (relic_init() != RLC_OK)
+  {
+    fprintf(stderr, "Failed to initialize RELIC\n");
     return -1;
   }
+  if (bench)
+  {
+    int res = curve_bench(stdout, BENCH_DEFAULT_ITERATIONS);
+    relic_cleanup();
+    return res;
+  }
+  if (compare)
+  {
+    int res = request_compare(stdout, num_data_points, COMPARE_DEFAULT_ITERATIONS);
+    relic_cleanup();
+    return res;
+  }
+  /* Sign on several cores, 0 picks one thread per core */
+  sign_pool_t sign_pool;
+  sign_pool_t *signers = NULL;
+  if (sign_threads < 0)
+  {
+    fprintf(stderr, "Signing threads must not be negative\n");
+    return -1;
+  }
+  if (rotate_messages < 0 || rotate_seconds < 0)
+  {
+    fprintf(stderr, "Key rotation intervals must not be negative\n");
+    return -1;
+  }
+  if (sign_threads != 1)
+  {
+    if (sign_pool_init(&sign_pool, sign_threads) != 0)
+      return -1;
+    signers = &sign_pool;
+  }
   g2_t pk;
   bn_t sk;
   g2_null(pk);
   bn_null(sk);
   g2_new(pk);
   bn_new(sk);
-  char *pk_b64_custom = NULL;
+  const char *pk_b64 = NULL;
+  keystore_t keystore;
+  /* Load the device's keys instead of generating them */
+  if (keystore_path != NULL)
+  {
+    if (keystore_open(&keystore, keystore_path) != 0)
+      return -1;
+    const keystore_record_t *record = keystore_find(&keystore, DEVICE_ID);
+    if (record == NULL)
+    {
+      fprintf(stderr, "Device %s is not in keystore %s\n", DEVICE_ID, keystore_path);
+      keystore_close(&keystore);
+      return -1;
+    }
+    if (keystore_load(record, sk, pk) != 0)
+    {
+      keystore_close(&keystore);
+      return -1;
+    }
+    pk_b64 = record->pk_b64;
+    iterations = iterations_count;
+  }
   while (iterations < iterations_count)
   {
 #ifdef TEST_MODE
@@ -45,147 +452,197 @@ int main(int argc, char *argv[])
       fprintf(stderr, "Failed to generate keys\n");
       return -1;
     }
-    /* Format and encode the public key */
-    int pk_len = g2_size_bin(pk, 1);
-    char pk_buffer[pk_len];
-    g2_write_bin((uint8_t *)pk_buffer, pk_len, pk, 1);
-    size_t encoded_len;
-    pk_b64_custom = base64_enc(pk_buffer, pk_len, &encoded_len);
     iterations++;
 #ifdef TEST_MODE
     timer_end(start_setup_keys, "genkeys");
 #endif
   }
-  iterations = 0;
-  while (iterations < iterations_count)
+  /* Precompute sk·G so signing needs one scalar multiplication per point, encode the
+     public key once and generate the next key in the background if keys rotate */
+  key_manager_t keys;
+  int keys_res = key_manager_init(&keys, sk, pk, pk_b64, rotate_messages, rotate_seconds * 1000);
+  if (keystore_path != NULL)
+    keystore_close(&keystore);
+  if (keys_res != 0)
+    return -1;
+  /* Messages are reset and reused, so building a batch does not allocate */
+  message_pool_t message_pool;
+  if (message_pool_init(&message_pool, MESSAGE_POOL_DEFAULT_SIZE, num_data_points) != 0)
+    return -1;
+  /* The constant fields of a JSON request are rendered once per key */
+  request_template_t request;
+  if (request_template_init(&request) != 0)
+    return -1;
+  signing_t signing = {&keys, signers, NULL, NULL, &message_pool, &request};
+  /* Hash tags in the background so only the value-dependent part is signed online */
+  presign_t presign;
+  if (use_presign)
   {
-#ifdef TEST_MODE
-    struct timeval start_init = timer_start();
-#endif
-    uint64_t scale = 1;
-    /* Allocate the data points */
-    dig_t *data_points = (dig_t *)malloc(sizeof(dig_t) * NUM_DATA_POINTS);
-    if (data_points == NULL)
-    {
-      fprintf(stderr, "Could not allocate data points\n");
-      return -1;
-    }
-    /* Generate data points based on arguments */
-    int gen_res = gen_dig_data_points(data_points, NUM_DATA_POINTS);
-    if (gen_res != 0)
-    {
-      fprintf(stderr, "Failed to generate data points\n");
-      return -1;
-    }
-    message_t *message = (message_t *)malloc(sizeof(message_t));
-    if (message == NULL)
-    {
-      fprintf(stderr, "Could not allocate message\n");
-      free(data_points);
+    if (presign_init(&presign, &keys.current->signer, TEST_DATABASE, DEVICE_ID, PRESIGN_CAPACITY) != 0)
       return -1;
-    }
-    /* Initialize the message */
-    int init_res = init_message(message, data_points, NUM_DATA_POINTS);
-    if (init_res != 0)
-    {
-      fprintf(stderr, "Failed to initialize message\n");
-      free(message);
-      free(data_points);
+    signing.presign = &presign;
+  }
+  /* Verify a sample of the signatures on a background thread within a CPU budget */
+  verifier_t verifier;
+  if (verify_percent > 0)
+  {
+    if (verifier_init(&verifier, verify_percent / 100, VERIFIER_DEFAULT_BUDGET) != 0)
       return -1;
-    }
-#ifdef TEST_MODE
-    timer_end(start_init, "init");
-    struct timeval start_sign = timer_start();
-#endif
-    /* Sign the data points */
-    int sign_res = sign_data_points(message, sk, NUM_DATA_POINTS);
-    if (sign_res != 0)
+    signing.verifier = &verifier;
+  }
+  if (rate > 0)
+  {
+    int requests = (iterations_count + messages_per_request - 1) / messages_per_request;
+    int res = run_open_loop(&endpoint, path, rate, arrival, requests, messages_per_request,
+                            &signing, binary);
+    signing_free(&signing);
+    return res;
+  }
+  conn_pool_t pool;
+  const char *content_type = binary ? BINARY_CONTENT_TYPE : JSON_CONTENT_TYPE;
+  if (pool_init(&pool, &endpoint, path, content_type, POOL_DEFAULT_SIZE) != 0)
+  {
+    printf("Failed to connect to server\n");
+    return -1;
+  }
+  /* Re-send slow requests on a second connection */
+  hedge_t hedge;
+  if (hedge_percentile != 0 && hedge_init(&hedge, hedge_percentile) != 0)
+  {
+    fprintf(stderr, "Hedge percentile must be between 1 and 99\n");
+    return -1;
+  }
+  /* io_uring backend, falls back to sockets if the kernel does not have it */
+  uring_t uring;
+  if (use_uring)
+  {
+    if (uring_init(&uring, window, JSON_BUFFER_SIZE + HEADER_TEMPLATE_SIZE) == 0)
+      pool.uring = &uring;
+    else
+      fprintf(stderr, "io_uring not available, using sockets\n");
+  }
+  /* One JSON serializer per request in flight, each grows with the batch size */
+  json_t json[window];
+  batch_t batches[window];
+  pipeline_request_t reqs[window];
+  for (int b = 0; b < window; b++)
+  {
+    // With io_uring the body starts in the registered arena and only moves
+    // to the heap if it outgrows its slot
+    size_t capacity = 0;
+    char *body = pool.uring != NULL ? uring_body(pool.uring, b, &capacity) : NULL;
+    if (json_init_growable(&json[b], body, capacity) != 0)
     {
-      fprintf(stderr, "Failed to sign data points\n");
-      cleanup_message(message, NUM_DATA_POINTS);
-      free(message);
-      free(data_points);
+      fprintf(stderr, "Could not allocate request buffers\n");
       return -1;
     }
+  }
+  iterations = 0;
 #ifdef TEST_MODE
-    timer_end(start_sign, "sign");
-#endif
-    /* Encode signatures */
-    unsigned char *master_sig_buf[NUM_DATA_POINTS];
-    char *master_decoded_sig_buf[NUM_DATA_POINTS];
-#ifdef TEST_MODE
-    struct timeval start_encode = timer_start();
+  /* Buffers grow during the first window, after that the loop should not allocate */
+  size_t warm_allocs = 0;
+  int warm = 0;
 #endif
-    int sig_len = g1_size_bin(message->sigs[0], 1);
-    int encode_res = encode_signatures(message, master_sig_buf,
-                                       master_decoded_sig_buf, NUM_DATA_POINTS);
-    if (encode_res != 0)
+  while (iterations < iterations_count)
+  {
+    /* Swap keys between requests, every message of a request has the same key */
+    mklhs_key_t *retired = key_manager_rotate(&keys);
+    if (retired != NULL)
     {
-      fprintf(stderr, "Failed to encode signatures\n");
-      cleanup_message(message, NUM_DATA_POINTS);
-      free(message);
-      free(data_points);
-      return -1;
+      if (signing.presign != NULL)
+        presign_rekey(signing.presign, &keys.current->signer);
+      key_free(retired);
     }
-#ifdef TEST_MODE
-    timer_end(start_encode, "encode");
-    struct timeval start_prepare = timer_start();
-#endif
-    /* Print the JSON object */
-    char json_buffer[JSON_BUFFER_SIZE]; // Adjust size based on expected data volume
-    json_t json;
-    json_init(&json, json_buffer, sizeof(json_buffer));
-    int prepare_json = prepare_req_server(&json, message, master_decoded_sig_buf,
-                                          data_points, NUM_DATA_POINTS, pk_b64_custom, sig_len,
-                                          scale, FUNC);
-    if (prepare_json != 0)
+    uint64_t scale = 1;
+    /* Every request carries up to messages_per_request messages */
+    int batch = 0;
+    int queued = 0;
+    while (batch < window && iterations + queued < iterations_count)
     {
-      fprintf(stderr, "Failed to prepare request\n");
-      cleanup_message(message, NUM_DATA_POINTS);
-      free(message);
-      free(data_points);
-      return -1;
+      int b = batch++;
+      int count = iterations_count - iterations - queued;
+      if (count > messages_per_request)
+        count = messages_per_request;
+      queued += count;
+      if (messages_per_request > 1)
+      {
+        if (batch_init(&batches[b], &json[b], count, keys.current->pk_b64, scale, FUNC) != 0)
+          return -1;
+        for (int m = 0; m < count; m++)
+        {
+          if (build_batch(NULL, &batches[b], &signing, scale, 0) != 0)
+            return -1;
+        }
+        if (batch_finish(&batches[b]) != 0)
+          return -1;
+      }
+      else
+      {
+        json_reset(&json[b]);
+        if (build_batch(&json[b], NULL, &signing, scale, binary) != 0)
+          return -1;
+      }
+      reqs[b].body = json[b].buffer;
+      reqs[b].body_len = json[b].pos;
+      reqs[b].response = NULL;
+      reqs[b].response_size = 0;
     }
 #ifdef TEST_MODE
-    timer_end(start_prepare, "prepare");
     struct timeval start_req = timer_start();
 #endif
-    /* Clean up message resources */
-    cleanup_message(message, NUM_DATA_POINTS);
-    free(message);
-
-    // Free encoded signatures
-    for (int i = 0; i < NUM_DATA_POINTS; i++)
-    {
-      free(master_decoded_sig_buf[i]);
-      free(master_sig_buf[i]);
-    }
-    // Format and send POST
-    char request[BUFFER_SIZE];
-    request_t req;
-    if (setup_POST(request, sockfd, &req, json.buffer, "/new", SERVER_IP) != 0)
+    if (batch == 1 && pool.uring == NULL)
     {
-      fprintf(stderr, "Failed to setup POST request\n");
-      free(data_points);
-      return -1;
+      // Send POST on a pooled keep-alive connection
+      char response[BUFFER_SIZE];
+      int res;
+      if (hedge_percentile != 0)
+        res = pool_POST_hedged(&hedge, &pool, response, sizeof(response), json[0].buffer, json[0].pos);
+      else
+        res = pool_POST(&pool, response, sizeof(response), path, json[0].buffer, json[0].pos);
+      if (res < 0)
+      {
+        fprintf(stderr, "Failed to send POST request\n");
+        return -1;
+      }
     }
-    char response[BUFFER_SIZE];
-    int res = http_POST(response, &req, sizeof(response));
-    if (res < 0)
+    else
     {
-      fprintf(stderr, "Failed to send POST request\n");
-      free(data_points);
-      return -1;
+      // Keep the whole batch in flight on one connection
+      int answered = pool_POST_pipelined(&pool, reqs, batch, window);
+      if (answered < batch)
+      {
+        fprintf(stderr, "Failed to send %d of %d pipelined POST requests\n",
+                answered < 0 ? batch : batch - answered, batch);
+        return -1;
+      }
     }
     // ok
     printf("ok\n");
 #ifdef TEST_MODE
     timer_end(start_req, "request");
 #endif
-    /* Cleanup for this iteration */
-    free(data_points);
-    iterations++;
+    key_manager_signed(&keys, queued);
+    iterations += queued;
+#ifdef TEST_MODE
+    if (!warm)
+    {
+      warm_allocs = alloc_count();
+      warm = 1;
+    }
+#endif
   }
-  free(pk_b64_custom);
+#ifdef TEST_MODE
+  printf("Heap allocations after warm-up: %zu\n", alloc_count() - warm_allocs);
+#endif
+  if (keys.running)
+    printf("Rotated keys %zu times, the next key was not ready %zu times\n", keys.rotations, keys.late);
+  for (int b = 0; b < window; b++)
+    json_free(&json[b]);
+  signing_free(&signing);
+  if (hedge_percentile != 0)
+    hedge_destroy(&hedge);
+  pool_destroy(&pool);
+  if (pool.uring != NULL)
+    uring_destroy(pool.uring);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,127 @@
+#include <time.h>
+
+#include "bench.h"
+#include "curve.h"
+#include "../mklhs/signer.h"
+#include "../../utils/utils.h"
+
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_free_encoded(unsigned char *master[], char *master_decoded[])
+{
+    for (int i = 0; i < NUM_DATA_POINTS; i++)
+    {
+        free(master[i]);
+        free(master_decoded[i]);
+    }
+}
+
+// One row of the table for the curve set in this thread's context
+static int bench_curve(FILE *out, const char *name, size_t iterations)
+{
+    int result = -1;
+    bn_t sk;
+    g2_t pk;
+    bn_null(sk);
+    g2_null(pk);
+    bn_new(sk);
+    g2_new(pk);
+    message_t message;
+    mklhs_signer_t signer;
+    int have_signer = 0;
+    unsigned char *master[NUM_DATA_POINTS] = {NULL};
+    char *master_decoded[NUM_DATA_POINTS] = {NULL};
+
+    double start = bench_now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        if (cp_mklhs_gen(sk, pk) != RLC_OK)
+        {
+            fprintf(stderr, "Failed to generate keys on %s\n", name);
+            goto cleanup;
+        }
+    }
+    double keygen_s = bench_now() - start;
+
+    dig_t data_points[NUM_DATA_POINTS];
+    if (gen_dig_data_points(data_points, NUM_DATA_POINTS) != 0 ||
+        init_message(&message, data_points, NUM_DATA_POINTS) != 0)
+        goto cleanup;
+    if (signer_init(&signer, sk) != 0)
+        goto cleanup_message;
+    have_signer = 1;
+
+    // Signing and encoding alternate like in the client, each is timed on its own
+    double sign_s = 0;
+    double encode_s = 0;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        start = bench_now();
+        if (signer_sign_points(&signer, &message, 0, NUM_DATA_POINTS) != 0)
+            goto cleanup_message;
+        double signed_at = bench_now();
+        int encode_res = encode_signatures(&message, master, master_decoded, NUM_DATA_POINTS);
+        encode_s += bench_now() - signed_at;
+        sign_s += signed_at - start;
+        if (encode_res != 0)
+            goto cleanup_message;
+        bench_free_encoded(master, master_decoded);
+    }
+
+    int sig_len = g1_size_bin(message.sigs[0], 1);
+    int pk_len = g2_size_bin(pk, 1);
+    double points = (double)iterations * NUM_DATA_POINTS;
+    fprintf(out, "%-10s %5d %8d %10.1f %12.1f %12.1f %9d %9zu %8zu\n", name, pc_param_level(),
+            FP_PRIME, iterations / keygen_s, points / sign_s, points / encode_s, sig_len,
+            base64_out_len(sig_len), base64_out_len(pk_len));
+    result = 0;
+
+cleanup_message:
+    cleanup_message(&message);
+cleanup:
+    if (have_signer)
+        signer_free(&signer);
+    bn_free(sk);
+    g2_free(pk);
+    return result;
+}
+
+int curve_bench(FILE *out, size_t iterations)
+{
+    if (iterations == 0)
+        return -1;
+    const curve_info_t *chosen = curve_selected();
+    size_t count;
+    const curve_info_t *curves = curve_list(&count);
+
+    fprintf(out, "%-10s %5s %8s %10s %12s %12s %9s %9s %8s\n", "curve", "level", "fp_bits",
+            "keygen/s", "sign pts/s", "encode pts/s", "sig bytes", "sig b64", "pk b64");
+    int result = 0;
+    for (size_t c = 0; c < count && result == 0; c++)
+    {
+        curve_select(&curves[c]);
+        if (curve_set() != RLC_OK)
+            result = -1;
+        else
+            result = bench_curve(out, curves[c].name, iterations);
+    }
+    // A build without a listed curve still reports RELIC's default
+    if (count == 0)
+    {
+        curve_select(NULL);
+        if (curve_set() != RLC_OK)
+            result = -1;
+        else
+            result = bench_curve(out, "default", iterations);
+    }
+
+    curve_select(chosen);
+    if (curve_set() != RLC_OK)
+        result = -1;
+    return result;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file bench.h
+ * @brief Cost and size of signing on every available curve
+ *
+ * For each curve from curve_list() the benchmark measures key generation,
+ * signing with the precomputed signer and encoding of the signatures, and
+ * reports the bytes a data point's signature takes on the wire. Curves of
+ * other field sizes need another RELIC build, the rows of separate runs
+ * line up.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+#define BENCH_DEFAULT_ITERATIONS 100
+
+/**
+ * @brief Measures every available curve and prints one row per curve
+ *
+ * The curve chosen with curve_select() is set again afterwards.
+ *
+ * @param out Stream to print the table to
+ * @param iterations Keys generated and messages of NUM_DATA_POINTS signed per curve
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int curve_bench(FILE *out, size_t iterations);
+
+#endif
@@ -0,0 +1,97 @@
+#include <strings.h>
+
+#include "curve.h"
+
+// The same curves and twists as ep_param_set_any_pairf(), plus the other
+// curves RELIC has over the same field
+static const curve_info_t curve_table[] = {
+#if FP_PRIME == 158
+    {"BN_P158", BN_P158, RLC_EP_DTYPE},
+#elif FP_PRIME == 254
+    {"BN_P254", BN_P254, RLC_EP_DTYPE},
+#elif FP_PRIME == 256
+    {"BN_P256", BN_P256, RLC_EP_DTYPE},
+    {"SM9_P256", SM9_P256, RLC_EP_MTYPE},
+#elif FP_PRIME == 377
+    {"B12_P377", B12_P377, RLC_EP_DTYPE},
+#elif FP_PRIME == 381
+    {"B12_P381", B12_P381, RLC_EP_MTYPE},
+#elif FP_PRIME == 382
+    {"BN_P382", BN_P382, RLC_EP_DTYPE},
+#elif FP_PRIME == 383
+    {"B12_P383", B12_P383, RLC_EP_MTYPE},
+#elif FP_PRIME == 446
+#ifdef FP_QNRES
+    {"B12_P446", B12_P446, RLC_EP_MTYPE},
+#else
+    {"BN_P446", BN_P446, RLC_EP_DTYPE},
+#endif
+#elif FP_PRIME == 455
+    {"B12_P455", B12_P455, RLC_EP_DTYPE},
+#elif FP_PRIME == 638
+#ifdef FP_QNRES
+    {"B12_P638", B12_P638, RLC_EP_MTYPE},
+#else
+    {"BN_P638", BN_P638, RLC_EP_DTYPE},
+#endif
+#endif
+    {NULL, 0, 0},
+};
+
+static const curve_info_t *selected = NULL;
+
+const curve_info_t *curve_list(size_t *count)
+{
+    *count = sizeof(curve_table) / sizeof(curve_table[0]) - 1;
+    return curve_table;
+}
+
+const curve_info_t *curve_find(const char *name)
+{
+    for (const curve_info_t *curve = curve_table; curve->name != NULL; curve++)
+    {
+        if (strcasecmp(curve->name, name) == 0)
+            return curve;
+    }
+    return NULL;
+}
+
+void curve_select(const curve_info_t *curve)
+{
+    selected = curve;
+}
+
+const curve_info_t *curve_selected()
+{
+    return selected;
+}
+
+int curve_set()
+{
+    if (selected == NULL)
+        return pc_param_set_any();
+    int result = RLC_OK;
+    RLC_TRY
+    {
+        ep_param_set(selected->id);
+        ep2_curve_set_twist(selected->twist);
+    }
+    RLC_CATCH_ANY
+    {
+        result = RLC_ERR;
+    }
+    if (result != RLC_OK || ep_param_get() != selected->id)
+    {
+        fprintf(stderr, "Could not set curve %s\n", selected->name);
+        return RLC_ERR;
+    }
+    return RLC_OK;
+}
+
+void curve_print_list(FILE *out)
+{
+    fprintf(out, "Curves over the %d-bit field of this RELIC build:", FP_PRIME);
+    for (const curve_info_t *curve = curve_table; curve->name != NULL; curve++)
+        fprintf(out, " %s", curve->name);
+    fprintf(out, "\n");
+}
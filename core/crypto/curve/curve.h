@@ -0,0 +1,78 @@
+/**
+ * @file curve.h
+ * @brief Runtime selection of the pairing-friendly curve
+ *
+ * RELIC fixes the size of the prime field at build time (FP_PRIME), and
+ * pc_param_set_any() then picks one curve over it. This module lists the
+ * pairing curves with an embedding degree of 12 or less that RELIC
+ * provides over the built field, so one of them can be chosen at startup.
+ * The choice is process-wide: call curve_select() before any thread is
+ * started, and set up every RELIC context with curve_set() instead of
+ * pc_param_set_any().
+ *
+ * @note Curves over another field size need RELIC rebuilt with a different
+ *       FP_PRIME. The benchmark output of such builds can be compared.
+ */
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <stdio.h>
+#include <relic/relic.h>
+
+/**
+ * @brief A pairing-friendly curve the linked RELIC provides
+ */
+typedef struct curve_info
+{
+    const char *name; /**< RELIC's name of the parameter set */
+    int id;           /**< Parameter set passed to ep_param_set() */
+    int twist;        /**< Type of the sextic twist G2 lies on */
+} curve_info_t;
+
+/**
+ * @brief Returns the curves available in this build
+ *
+ * @param count Output number of curves
+ *
+ * @return Returns the array of curves
+ */
+const curve_info_t *curve_list(size_t *count);
+
+/**
+ * @brief Looks up a curve by name, ignoring case
+ *
+ * @param name Name of the curve, like "B12_P381"
+ *
+ * @return Returns the curve, or NULL if this build does not have it
+ */
+const curve_info_t *curve_find(const char *name);
+
+/**
+ * @brief Chooses the curve every RELIC context is set up with
+ *
+ * @param curve The curve, NULL for RELIC's default from pc_param_set_any()
+ */
+void curve_select(const curve_info_t *curve);
+
+/**
+ * @brief Returns the curve chosen with curve_select()
+ *
+ * @return Returns the curve, or NULL for RELIC's default
+ */
+const curve_info_t *curve_selected();
+
+/**
+ * @brief Sets the chosen curve in the calling thread's RELIC context
+ *
+ * @return RLC_OK on success, RLC_ERR otherwise
+ */
+int curve_set();
+
+/**
+ * @brief Prints the names of the available curves
+ *
+ * @param out Stream to print to
+ */
+void curve_print_list(FILE *out);
+
+#endif
@@ -0,0 +1,360 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "keystore.h"
+#include "../../utils/utils.h"
+
+/* A share of the records generated by one thread */
+typedef struct keystore_job
+{
+    keystore_record_t *records;
+    uint64_t first_id;
+    size_t from;
+    size_t to;
+    int curve; /**< Parameter set the keys were generated on */
+    int failed;
+    pthread_t thread;
+} keystore_job_t;
+
+// FNV-1a of the device id
+static uint32_t keystore_hash(const char *device_id)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < MAX_ID_LENGTH && device_id[i] != '\0'; i++)
+    {
+        hash ^= (uint8_t)device_id[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t keystore_table_size(size_t count)
+{
+    // At most half full, so probes stay short
+    size_t table_size = 1;
+    while (table_size < 2 * count)
+        table_size <<= 1;
+    return table_size;
+}
+
+// The strings of a record read from the file are terminated within their fields
+static int keystore_record_valid(const keystore_record_t *record)
+{
+    return memchr(record->device_id, '\0', sizeof(record->device_id)) != NULL &&
+           memchr(record->pk_b64, '\0', sizeof(record->pk_b64)) != NULL &&
+           record->sk_len <= sizeof(record->sk) && record->pk_len <= sizeof(record->pk);
+}
+
+static size_t keystore_file_size(size_t count, size_t table_size)
+{
+    return sizeof(keystore_header_t) + table_size * sizeof(uint32_t) +
+           count * sizeof(keystore_record_t);
+}
+
+static int keystore_fill(keystore_record_t *record, uint64_t device_id)
+{
+    int result = 0;
+    bn_t sk;
+    g2_t pk;
+    bn_null(sk);
+    g2_null(pk);
+    RLC_TRY
+    {
+        bn_new(sk);
+        g2_new(pk);
+        if (cp_mklhs_gen(sk, pk) != RLC_OK)
+        {
+            result = -1;
+        }
+        else
+        {
+            int sk_len = bn_size_bin(sk);
+            int pk_len = g2_size_bin(pk, 1);
+            if (sk_len > (int)sizeof(record->sk) || pk_len > (int)sizeof(record->pk))
+            {
+                result = -1;
+            }
+            else
+            {
+                snprintf(record->device_id, sizeof(record->device_id), "%llu",
+                         (unsigned long long)device_id);
+                bn_write_bin(record->sk, sk_len, sk);
+                g2_write_bin(record->pk, pk_len, pk, 1);
+                record->sk_len = (uint16_t)sk_len;
+                record->pk_len = (uint16_t)pk_len;
+            }
+        }
+    }
+    RLC_CATCH_ANY
+    {
+        result = -1;
+    }
+    RLC_FINALLY
+    {
+        bn_free(sk);
+        g2_free(pk);
+    }
+    if (result != 0)
+        return -1;
+
+    size_t encoded_len;
+    char *encoded = base64_enc((char *)record->pk, record->pk_len, &encoded_len);
+    if (encoded == NULL || encoded_len >= sizeof(record->pk_b64))
+    {
+        free(encoded);
+        return -1;
+    }
+    memcpy(record->pk_b64, encoded, encoded_len + 1);
+    free(encoded);
+    return 0;
+}
+
+static void *keystore_worker(void *arg)
+{
+    keystore_job_t *job = (keystore_job_t *)arg;
+
+    if (relic_thread_init(0) != RLC_OK)
+    {
+        job->failed = 1;
+        return NULL;
+    }
+    job->curve = ep_param_get();
+    for (size_t i = job->from; i < job->to && !job->failed; i++)
+    {
+        if (keystore_fill(&job->records[i], job->first_id + i) != 0)
+            job->failed = 1;
+    }
+    relic_thread_cleanup();
+    return NULL;
+}
+
+int keystore_open(keystore_t *keystore, const char *path)
+{
+    memset(keystore, 0, sizeof(keystore_t));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Could not open keystore");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(keystore_header_t))
+    {
+        fprintf(stderr, "Keystore %s is too small\n", path);
+        close(fd);
+        return -1;
+    }
+    uint8_t *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("Could not map keystore");
+        return -1;
+    }
+
+    const keystore_header_t *header = (const keystore_header_t *)map;
+    if (memcmp(header->magic, KEYSTORE_MAGIC, sizeof(KEYSTORE_MAGIC)) != 0 ||
+        header->version != KEYSTORE_VERSION ||
+        header->record_size != sizeof(keystore_record_t) ||
+        header->table_size == 0 || (header->table_size & (header->table_size - 1)) != 0 ||
+        (uint64_t)header->table_size < 2 * (uint64_t)header->count ||
+        keystore_file_size(header->count, header->table_size) != (size_t)st.st_size)
+    {
+        fprintf(stderr, "Keystore %s is corrupt or from another version\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    if (header->fp_prime != FP_PRIME || header->curve != (uint32_t)ep_param_get())
+    {
+        fprintf(stderr, "Keystore %s has keys for another curve than the one in use\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    // Every lookup touches one slot and one record, read-ahead would be wasted
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    keystore->map = map;
+    keystore->size = st.st_size;
+    keystore->header = header;
+    keystore->slots = (const uint32_t *)(map + sizeof(keystore_header_t));
+    keystore->records = (const keystore_record_t *)(keystore->slots + header->table_size);
+    return 0;
+}
+
+const keystore_record_t *keystore_find(const keystore_t *keystore, const char *device_id)
+{
+    uint32_t table_size = keystore->header->table_size;
+    uint32_t mask = table_size - 1;
+    uint32_t i = keystore_hash(device_id) & mask;
+    // The table is at most half full, a longer probe means the file is corrupt
+    for (uint32_t probes = 0; probes < table_size; probes++, i = (i + 1) & mask)
+    {
+        uint32_t slot = keystore->slots[i];
+        if (slot == 0)
+            return NULL;
+        if (slot > keystore->header->count)
+            break;
+        const keystore_record_t *record = &keystore->records[slot - 1];
+        if (strncmp(record->device_id, device_id, MAX_ID_LENGTH) != 0)
+            continue;
+        if (!keystore_record_valid(record))
+            break;
+        return record;
+    }
+    fprintf(stderr, "Keystore is corrupt\n");
+    return NULL;
+}
+
+int keystore_load(const keystore_record_t *record, bn_t sk, g2_t pk)
+{
+    if (!keystore_record_valid(record))
+    {
+        fprintf(stderr, "Keystore record is corrupt\n");
+        return -1;
+    }
+    int result = 0;
+    RLC_TRY
+    {
+        bn_read_bin(sk, record->sk, record->sk_len);
+        g2_read_bin(pk, record->pk, record->pk_len);
+    }
+    RLC_CATCH_ANY
+    {
+        fprintf(stderr, "Could not read the keys of %s\n", record->device_id);
+        result = -1;
+    }
+    return result;
+}
+
+void keystore_close(keystore_t *keystore)
+{
+    if (keystore->map != NULL)
+        munmap(keystore->map, keystore->size);
+    memset(keystore, 0, sizeof(keystore_t));
+}
+
+int keystore_create(const char *path, uint64_t first_id, size_t count, size_t num_threads)
+{
+    if (count == 0 || count > KEYSTORE_MAX_DEVICES)
+    {
+        fprintf(stderr, "Number of devices must be between 1 and %d\n", KEYSTORE_MAX_DEVICES);
+        return -1;
+    }
+    if (num_threads == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cores > 0 ? (size_t)cores : 1;
+    }
+    if (num_threads > count)
+        num_threads = count;
+
+    // Write next to the target and rename, so clients never map a half-written file
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+    {
+        fprintf(stderr, "Keystore path is too long\n");
+        return -1;
+    }
+    size_t table_size = keystore_table_size(count);
+    size_t size = keystore_file_size(count, table_size);
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        perror("Could not create keystore");
+        return -1;
+    }
+    if (ftruncate(fd, size) != 0)
+    {
+        perror("Could not size keystore");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("Could not map keystore");
+        unlink(tmp_path);
+        return -1;
+    }
+    keystore_header_t *header = (keystore_header_t *)map;
+    uint32_t *slots = (uint32_t *)(map + sizeof(keystore_header_t));
+    keystore_record_t *records = (keystore_record_t *)(slots + table_size);
+
+    int result = 0;
+    keystore_job_t *jobs = (keystore_job_t *)calloc(num_threads, sizeof(keystore_job_t));
+    if (jobs == NULL)
+    {
+        fprintf(stderr, "Could not allocate keygen threads\n");
+        result = -1;
+        goto cleanup;
+    }
+    size_t started = 0;
+    for (; started < num_threads; started++)
+    {
+        keystore_job_t *job = &jobs[started];
+        job->records = records;
+        job->first_id = first_id;
+        job->from = count * started / num_threads;
+        job->to = count * (started + 1) / num_threads;
+        if (pthread_create(&job->thread, NULL, keystore_worker, job) != 0)
+        {
+            fprintf(stderr, "Could not start keygen thread\n");
+            result = -1;
+            break;
+        }
+    }
+    for (size_t i = 0; i < started; i++)
+    {
+        pthread_join(jobs[i].thread, NULL);
+        if (jobs[i].failed)
+            result = -1;
+    }
+    int curve = started > 0 ? jobs[0].curve : 0;
+    free(jobs);
+    if (result != 0)
+    {
+        fprintf(stderr, "Failed to generate keys\n");
+        goto cleanup;
+    }
+
+    // Index the records, the file is fresh so every slot starts empty
+    uint32_t mask = (uint32_t)table_size - 1;
+    for (size_t r = 0; r < count; r++)
+    {
+        uint32_t i = keystore_hash(records[r].device_id) & mask;
+        while (slots[i] != 0)
+            i = (i + 1) & mask;
+        slots[i] = (uint32_t)r + 1;
+    }
+    header->version = KEYSTORE_VERSION;
+    header->fp_prime = FP_PRIME;
+    header->curve = (uint32_t)curve;
+    header->record_size = sizeof(keystore_record_t);
+    header->count = (uint32_t)count;
+    header->table_size = (uint32_t)table_size;
+    memcpy(header->magic, KEYSTORE_MAGIC, sizeof(KEYSTORE_MAGIC));
+    if (msync(map, size, MS_SYNC) != 0)
+    {
+        perror("Could not write keystore");
+        result = -1;
+    }
+
+cleanup:
+    munmap(map, size);
+    if (result == 0 && rename(tmp_path, path) != 0)
+    {
+        perror("Could not replace keystore");
+        result = -1;
+    }
+    if (result != 0)
+        unlink(tmp_path);
+    return result;
+}
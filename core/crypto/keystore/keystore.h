@@ -0,0 +1,129 @@
+/**
+ * @file keystore.h
+ * @brief Memory-mapped file of MKLHS key pairs for many devices
+ *
+ * The keystore holds one fixed-size record per device: its identity, the
+ * serialized secret and public key and the base64 public key as it is sent
+ * in requests. Behind the header is an open-addressing hash table of device
+ * ids, so finding a device is O(1) and only touches the pages of its slot
+ * and record. Keys are generated once with the keygen tool and then loaded
+ * at startup instead of being generated again.
+ *
+ * File layout:
+ *   keystore_header_t | uint32_t slots[table_size] | keystore_record_t records[count]
+ *
+ * @note The file holds secret keys and is created with mode 0600.
+ */
+#ifndef KEYSTORE_H
+#define KEYSTORE_H
+
+#include <stdint.h>
+#include <relic/relic.h>
+
+#include "../../message/message.h"
+
+#define KEYSTORE_MAGIC "OCPKEYS"
+#define KEYSTORE_VERSION 1
+#define KEYSTORE_DEFAULT_PATH "data/keystore.bin"
+#define KEYSTORE_MAX_DEVICES (1 << 24)
+#define KEYSTORE_SK_SIZE (RLC_FP_BYTES + 1)
+#define KEYSTORE_PK_SIZE (2 * RLC_FP_BYTES + 1) /* Compressed G2 point */
+#define KEYSTORE_PK_B64_SIZE (4 * ((KEYSTORE_PK_SIZE + 2) / 3) + 1)
+
+/**
+ * @brief Header at the start of the file
+ */
+typedef struct keystore_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t fp_prime;    /**< FP_PRIME the keys were generated for */
+    uint32_t record_size; /**< sizeof(keystore_record_t) of the writer */
+    uint32_t count;       /**< Number of records */
+    uint32_t table_size;  /**< Number of hash slots, a power of two */
+    uint32_t curve;       /**< ep_param_get() of the curve the keys were generated on */
+} keystore_header_t;
+
+/**
+ * @brief Keys of one device
+ */
+typedef struct keystore_record
+{
+    char device_id[MAX_ID_LENGTH];
+    uint8_t sk[KEYSTORE_SK_SIZE];
+    uint8_t pk[KEYSTORE_PK_SIZE];
+    char pk_b64[KEYSTORE_PK_B64_SIZE];
+    uint16_t sk_len;
+    uint16_t pk_len;
+} keystore_record_t;
+
+/**
+ * @brief An open keystore
+ */
+typedef struct keystore
+{
+    uint8_t *map;
+    size_t size;
+    const keystore_header_t *header;
+    const uint32_t *slots;            /**< Record index + 1, 0 for an empty slot */
+    const keystore_record_t *records;
+} keystore_t;
+
+/**
+ * @brief Maps a keystore file read-only and checks its header
+ *
+ * The keys have to be for the curve set in the calling thread's context.
+ *
+ * @param keystore Pointer to the keystore to open
+ * @param path Path of the keystore file
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int keystore_open(keystore_t *keystore, const char *path);
+
+/**
+ * @brief Looks up the record of a device
+ *
+ * @param keystore Pointer to the open keystore
+ * @param device_id Identity of the device
+ *
+ * @return Returns the record, or NULL if the device is not in the keystore or
+ *         the keystore is corrupt
+ */
+const keystore_record_t *keystore_find(const keystore_t *keystore, const char *device_id);
+
+/**
+ * @brief Reads the key pair of a record
+ *
+ * @param record The record from keystore_find()
+ * @param sk Output secret key, must be allocated by the caller
+ * @param pk Output public key, must be allocated by the caller
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int keystore_load(const keystore_record_t *record, bn_t sk, g2_t pk);
+
+/**
+ * @brief Unmaps the keystore
+ *
+ * @param keystore Pointer to the keystore
+ */
+void keystore_close(keystore_t *keystore);
+
+/**
+ * @brief Generates key pairs for many devices in parallel and writes them to a keystore file
+ *
+ * The device ids are the decimal numbers first_id .. first_id + count - 1.
+ * Every thread sets up its own RELIC context with relic_thread_init() and writes its
+ * share of the records straight into the mapped file.
+ *
+ * @param path Path of the keystore file, replaced if it exists
+ * @param first_id Identity of the first device
+ * @param count Number of devices
+ * @param num_threads Number of threads, 0 for one per online core
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int keystore_create(const char *path, uint64_t first_id, size_t count, size_t num_threads);
+
+#endif
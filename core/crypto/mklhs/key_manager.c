@@ -0,0 +1,212 @@
+#include <time.h>
+#include "key_manager.h"
+#include "../../utils/utils.h"
+
+static uint64_t key_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+mklhs_key_t *key_new(bn_t sk, g2_t pk, const char *pk_b64)
+{
+    mklhs_key_t *key = (mklhs_key_t *)calloc(1, sizeof(mklhs_key_t));
+    if (key == NULL)
+    {
+        fprintf(stderr, "Could not allocate key\n");
+        return NULL;
+    }
+    int result = 0;
+    bn_null(key->sk);
+    g2_null(key->pk);
+    RLC_TRY
+    {
+        bn_new(key->sk);
+        g2_new(key->pk);
+        bn_copy(key->sk, sk);
+        g2_copy(key->pk, pk);
+        // Encode the public key once, every request of this key reuses it
+        int pk_len = g2_size_bin(pk, 1);
+        if (pk_len > (int)sizeof(key->pk_bin))
+        {
+            result = -1;
+        }
+        else
+        {
+            g2_write_bin(key->pk_bin, pk_len, pk, 1);
+            key->pk_len = pk_len;
+            size_t encoded_len;
+            key->pk_b64 = pk_b64 != NULL ? strdup(pk_b64)
+                                         : base64_enc((char *)key->pk_bin, pk_len, &encoded_len);
+        }
+    }
+    RLC_CATCH_ANY
+    {
+        result = -1;
+    }
+    if (result != 0 || key->pk_b64 == NULL)
+    {
+        fprintf(stderr, "Could not encode public key\n");
+        free(key->pk_b64);
+        bn_free(key->sk);
+        g2_free(key->pk);
+        free(key);
+        return NULL;
+    }
+    if (signer_init(&key->signer, key->sk) != 0)
+    {
+        free(key->pk_b64);
+        bn_free(key->sk);
+        g2_free(key->pk);
+        free(key);
+        return NULL;
+    }
+    return key;
+}
+
+void key_free(mklhs_key_t *key)
+{
+    if (key == NULL)
+        return;
+    signer_free(&key->signer);
+    free(key->pk_b64);
+    bn_free(key->sk);
+    g2_free(key->pk);
+    free(key);
+}
+
+static void *key_generator_loop(void *arg)
+{
+    key_manager_t *km = (key_manager_t *)arg;
+
+    // The next key is needed long after it is started, leave the CPU to signing
+    int ready = relic_thread_init(1) == RLC_OK;
+
+    bn_t sk;
+    g2_t pk;
+    bn_null(sk);
+    g2_null(pk);
+    bn_new(sk);
+    g2_new(pk);
+    pthread_mutex_lock(&km->lock);
+    if (!ready)
+    {
+        km->failed = 1;
+        fprintf(stderr, "Could not set up RELIC in the key generator thread\n");
+    }
+    while (ready && km->running)
+    {
+        if (km->next != NULL)
+        {
+            pthread_cond_wait(&km->wake, &km->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&km->lock);
+
+        mklhs_key_t *key = NULL;
+        if (cp_mklhs_gen(sk, pk) == RLC_OK)
+            key = key_new(sk, pk, NULL);
+
+        pthread_mutex_lock(&km->lock);
+        if (key == NULL)
+        {
+            km->failed = 1;
+            fprintf(stderr, "Failed to generate the next key\n");
+            break;
+        }
+        km->next = key;
+    }
+    pthread_mutex_unlock(&km->lock);
+    bn_free(sk);
+    g2_free(pk);
+    if (ready)
+        relic_thread_cleanup();
+    return NULL;
+}
+
+int key_manager_init(key_manager_t *km, bn_t sk, g2_t pk, const char *pk_b64,
+                     size_t rotate_messages, uint64_t rotate_ms)
+{
+    memset(km, 0, sizeof(key_manager_t));
+    km->current = key_new(sk, pk, pk_b64);
+    if (km->current == NULL)
+        return -1;
+    km->rotate_messages = rotate_messages;
+    km->rotate_ms = rotate_ms;
+    km->since_ms = key_now_ms();
+    pthread_mutex_init(&km->lock, NULL);
+    pthread_cond_init(&km->wake, NULL);
+    if (rotate_messages == 0 && rotate_ms == 0)
+        return 0;
+
+    km->running = 1;
+    if (pthread_create(&km->generator, NULL, key_generator_loop, km) != 0)
+    {
+        fprintf(stderr, "Could not start key generator thread\n");
+        km->running = 0;
+        key_manager_destroy(km);
+        return -1;
+    }
+    return 0;
+}
+
+void key_manager_signed(key_manager_t *km, size_t messages)
+{
+    km->messages += messages;
+}
+
+mklhs_key_t *key_manager_rotate(key_manager_t *km)
+{
+    if (!km->running)
+        return NULL;
+    int due = (km->rotate_messages != 0 && km->messages >= km->rotate_messages) ||
+              (km->rotate_ms != 0 && key_now_ms() - km->since_ms >= km->rotate_ms);
+    if (!due)
+        return NULL;
+
+    pthread_mutex_lock(&km->lock);
+    mklhs_key_t *next = km->next;
+    if (next != NULL)
+    {
+        km->next = NULL;
+        pthread_cond_signal(&km->wake);
+    }
+    else if (!km->pending_late)
+    {
+        // Counted once per rotation, it stays due until the key is ready
+        km->pending_late = 1;
+        km->late++;
+    }
+    pthread_mutex_unlock(&km->lock);
+    if (next == NULL)
+        return NULL;
+
+    km->pending_late = 0;
+
+    mklhs_key_t *retired = km->current;
+    next->serial = retired->serial + 1;
+    km->current = next;
+    km->messages = 0;
+    km->since_ms = key_now_ms();
+    km->rotations++;
+    return retired;
+}
+
+void key_manager_destroy(key_manager_t *km)
+{
+    if (km->running)
+    {
+        pthread_mutex_lock(&km->lock);
+        km->running = 0;
+        pthread_cond_signal(&km->wake);
+        pthread_mutex_unlock(&km->lock);
+        pthread_join(km->generator, NULL);
+    }
+    pthread_cond_destroy(&km->wake);
+    pthread_mutex_destroy(&km->lock);
+    key_free(km->next);
+    key_free(km->current);
+    km->next = NULL;
+    km->current = NULL;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file key_manager.h
+ * @brief Key pair lifetime with background generation of the next key
+ *
+ * The manager holds the current key together with its signing tables and
+ * its base64 public key, encoded once when the key is made so requests can
+ * reuse it. While rotation is enabled, a low-priority background thread
+ * generates the next key pair ahead of time. key_manager_rotate() is called
+ * between requests and swaps the keys once enough messages were signed or
+ * enough time has passed. If the next key is not ready yet, the current one
+ * stays in use, so signing never waits for key generation.
+ */
+#ifndef KEY_MANAGER_H
+#define KEY_MANAGER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "signer.h"
+
+/**
+ * @brief A key pair and everything derived from it
+ */
+typedef struct mklhs_key
+{
+    bn_t sk;
+    g2_t pk;
+    char *pk_b64;          /**< Base64 of the compressed public key */
+    uint8_t pk_bin[2 * RLC_FP_BYTES + 1]; /**< The compressed public key */
+    int pk_len;            /**< Bytes of pk_bin in use */
+    mklhs_signer_t signer; /**< Precomputed tables of sk */
+    size_t serial;         /**< 0 for the first key, counts up with every rotation */
+} mklhs_key_t;
+
+/**
+ * @brief The current key and the generator of the next one
+ */
+typedef struct key_manager
+{
+    mklhs_key_t *current;
+    mklhs_key_t *next;      /**< Ready to be swapped in, NULL while it is generated */
+    size_t rotate_messages; /**< Rotate after this many messages, 0 for never */
+    uint64_t rotate_ms;     /**< Rotate after this long, 0 for never */
+    size_t messages;        /**< Messages signed with the current key */
+    uint64_t since_ms;      /**< When the current key was swapped in */
+    pthread_t generator;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    /**< Signals the generator that next was taken or shutdown */
+    int running;
+    int failed;             /**< The generator could not set up RELIC or make a key */
+    size_t rotations;       /**< Keys swapped in */
+    size_t late;            /**< Rotations put off because the next key was not ready */
+    int pending_late;       /**< The due rotation is already counted in late */
+} key_manager_t;
+
+/**
+ * @brief Derives the signing tables and the public key encoding of a key pair
+ *
+ * @param sk Secret key, copied
+ * @param pk Public key, copied
+ * @param pk_b64 Base64 of the compressed public key if it is known already, NULL to encode pk
+ *
+ * @return Returns the key, or NULL on failure. Free it with key_free().
+ */
+mklhs_key_t *key_new(bn_t sk, g2_t pk, const char *pk_b64);
+
+/**
+ * @brief Frees a key
+ *
+ * @param key The key, may be NULL
+ */
+void key_free(mklhs_key_t *key);
+
+/**
+ * @brief Takes the first key and starts generating the next one if rotation is enabled
+ *
+ * @param km Pointer to the key manager to initialize
+ * @param sk Secret key to start with, copied
+ * @param pk Public key to start with, copied
+ * @param pk_b64 Base64 of pk if it is known already, NULL to encode pk
+ * @param rotate_messages Rotate after this many signed messages, 0 for never
+ * @param rotate_ms Rotate after this many milliseconds, 0 for never
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int key_manager_init(key_manager_t *km, bn_t sk, g2_t pk, const char *pk_b64,
+                     size_t rotate_messages, uint64_t rotate_ms);
+
+/**
+ * @brief Counts messages signed with the current key
+ *
+ * @param km Pointer to the key manager
+ * @param messages Number of messages
+ */
+void key_manager_signed(key_manager_t *km, size_t messages);
+
+/**
+ * @brief Swaps in the next key if rotation is due and the key is ready
+ *
+ * Call it between requests, every message of a request has to be signed
+ * with the same key. Never waits for the generator.
+ *
+ * @param km Pointer to the key manager
+ *
+ * @return Returns the key that was retired, or NULL if the keys were not swapped.
+ *         Free it with key_free() once nothing signs with it anymore.
+ */
+mklhs_key_t *key_manager_rotate(key_manager_t *km);
+
+/**
+ * @brief Stops the generator and frees the keys
+ *
+ * @param km Pointer to the key manager
+ */
+void key_manager_destroy(key_manager_t *km);
+
+#endif
@@ -20,7 +20,7 @@ int sign_data_points(message_t *message, bn_t sk, size_t num_data_points)
     /* Sign all the datapoints */
     for (int i = 0; i < num_data_points; i++)
     {
-        int res_sign = cp_mklhs_sig(message->sigs[i], message->data_points[i], message->data_set_id, message->ids[0], message->tags[i], sk);
+        int res_sign = cp_mklhs_sig(message->sigs[i], message->data_points[i], message->data_set_id, message->id, message_tag(message, i), sk);
         if (res_sign != RLC_OK)
         {
             fprintf(stderr, "Could not sign message\n");
@@ -0,0 +1,167 @@
+#include "presign.h"
+#include "../../utils/utils.h"
+
+static void *presign_loop(void *arg)
+{
+    presign_t *presign = (presign_t *)arg;
+
+    // Only fill the ring when nothing else wants the CPU
+    int ready = relic_thread_init(1) == RLC_OK;
+
+    char tag[MAX_TAG_LENGTH];
+    g1_t point;
+    g1_null(point);
+    g1_new(point);
+    pthread_mutex_lock(&presign->lock);
+    if (!ready)
+    {
+        presign->failed = 1;
+        fprintf(stderr, "Could not set up RELIC in the presign thread\n");
+    }
+    while (ready && presign->running)
+    {
+        if (presign->count == presign->capacity)
+        {
+            pthread_cond_wait(&presign->not_full, &presign->lock);
+            continue;
+        }
+        const mklhs_signer_t *signer = presign->signer;
+        size_t epoch = presign->epoch;
+        presign->hashing = 1;
+        pthread_mutex_unlock(&presign->lock);
+
+        rand_str(tag, MAX_TAG_LENGTH - 1);
+        int res = signer_hash(signer, point, presign->data_set_id, presign->id, tag);
+
+        pthread_mutex_lock(&presign->lock);
+        presign->hashing = 0;
+        pthread_cond_broadcast(&presign->idle);
+        if (res != 0)
+        {
+            presign->failed = 1;
+            break;
+        }
+        // Hashed with a key that was rotated out meanwhile
+        if (epoch != presign->epoch)
+            continue;
+        presign_entry_t *entry = &presign->ring[(presign->head + presign->count) % presign->capacity];
+        bad_strncpy(entry->tag, tag, sizeof(entry->tag));
+        g1_copy(entry->point, point);
+        presign->count++;
+    }
+    pthread_mutex_unlock(&presign->lock);
+    g1_free(point);
+    if (ready)
+        relic_thread_cleanup();
+    return NULL;
+}
+
+int presign_init(presign_t *presign, const mklhs_signer_t *signer, const char *data_set_id,
+                 const char *id, size_t capacity)
+{
+    if (presign == NULL || signer == NULL || capacity == 0)
+    {
+        fprintf(stderr, "Invalid presign configuration\n");
+        return -1;
+    }
+    memset(presign, 0, sizeof(presign_t));
+    presign->ring = (presign_entry_t *)calloc(capacity, sizeof(presign_entry_t));
+    if (presign->ring == NULL)
+    {
+        fprintf(stderr, "Could not allocate presign ring\n");
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; i++)
+    {
+        g1_null(presign->ring[i].point);
+        g1_new(presign->ring[i].point);
+    }
+    presign->capacity = capacity;
+    presign->signer = signer;
+    bad_strncpy(presign->data_set_id, data_set_id, sizeof(presign->data_set_id));
+    bad_strncpy(presign->id, id, sizeof(presign->id));
+    pthread_mutex_init(&presign->lock, NULL);
+    pthread_cond_init(&presign->not_full, NULL);
+    pthread_cond_init(&presign->idle, NULL);
+    presign->running = 1;
+    if (pthread_create(&presign->producer, NULL, presign_loop, presign) != 0)
+    {
+        fprintf(stderr, "Could not start presign thread\n");
+        presign->running = 0;
+        pthread_cond_destroy(&presign->idle);
+        pthread_cond_destroy(&presign->not_full);
+        pthread_mutex_destroy(&presign->lock);
+        free(presign->ring);
+        presign->ring = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int presign_sign_points(presign_t *presign, message_t *message, size_t num_data_points)
+{
+    const mklhs_signer_t *signer = presign->signer;
+    // Precomputed points only fit messages of the same data set and identity
+    if (strcmp(message->data_set_id, presign->data_set_id) != 0 ||
+        strcmp(message->id, presign->id) != 0)
+        return signer_sign_points(signer, message, 0, num_data_points);
+
+    // Take as many precomputed tags as there are, the hashed part goes into the signature
+    pthread_mutex_lock(&presign->lock);
+    size_t taken = num_data_points < presign->count ? num_data_points : presign->count;
+    for (size_t i = 0; i < taken; i++)
+    {
+        presign_entry_t *entry = &presign->ring[presign->head];
+        // Precomputed tags are as long as the ones they replace
+        memcpy(message_tag(message, i), entry->tag, MAX_TAG_LENGTH);
+        g1_copy(message->sigs[i], entry->point);
+        presign->head = (presign->head + 1) % presign->capacity;
+    }
+    presign->count -= taken;
+    presign->hits += taken;
+    presign->misses += num_data_points - taken;
+    if (taken > 0)
+        pthread_cond_signal(&presign->not_full);
+    pthread_mutex_unlock(&presign->lock);
+
+    for (size_t i = 0; i < taken; i++)
+    {
+        if (signer_finish(signer, message->sigs[i], message->sigs[i], message->data_points[i]) != 0)
+        {
+            fprintf(stderr, "Could not sign message\n");
+            return -1;
+        }
+    }
+    return signer_sign_points(signer, message, taken, num_data_points);
+}
+
+void presign_rekey(presign_t *presign, const mklhs_signer_t *signer)
+{
+    pthread_mutex_lock(&presign->lock);
+    presign->signer = signer;
+    presign->epoch++;
+    presign->head = 0;
+    presign->count = 0;
+    pthread_cond_signal(&presign->not_full);
+    while (presign->hashing)
+        pthread_cond_wait(&presign->idle, &presign->lock);
+    pthread_mutex_unlock(&presign->lock);
+}
+
+void presign_destroy(presign_t *presign)
+{
+    if (presign->ring == NULL)
+        return;
+    pthread_mutex_lock(&presign->lock);
+    presign->running = 0;
+    pthread_cond_signal(&presign->not_full);
+    pthread_mutex_unlock(&presign->lock);
+    pthread_join(presign->producer, NULL);
+    pthread_cond_destroy(&presign->idle);
+    pthread_cond_destroy(&presign->not_full);
+    pthread_mutex_destroy(&presign->lock);
+    for (size_t i = 0; i < presign->capacity; i++)
+        g1_free(presign->ring[i].point);
+    free(presign->ring);
+    presign->ring = NULL;
+}
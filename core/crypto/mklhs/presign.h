@@ -0,0 +1,104 @@
+/**
+ * @file presign.h
+ * @brief Offline/online signing with precomputed hashed tags
+ *
+ * The expensive part of a signature, sk·H(data_set_id||id||tag), does not
+ * depend on the data point. A background producer thread generates random
+ * tags ahead of time and keeps their sk·H(...) points in a bounded ring
+ * buffer. Signing a message online then takes a tag and its point from the
+ * ring and only adds m·(sk·G) (see signer_finish()). When the ring runs dry,
+ * the remaining points are signed in full with the message's own tags.
+ *
+ * The producer runs at the lowest scheduling priority, so it fills the
+ * ring during idle time instead of competing with the online path.
+ */
+#ifndef PRESIGN_H
+#define PRESIGN_H
+
+#include <pthread.h>
+
+#include "signer.h"
+
+#define PRESIGN_CAPACITY 1024
+
+/**
+ * @brief A tag and its precomputed point sk·H(data_set_id||id||tag)
+ */
+typedef struct presign_entry
+{
+    char tag[MAX_TAG_LENGTH];
+    g1_t point;
+} presign_entry_t;
+
+/**
+ * @brief The ring of precomputed tags and its producer
+ */
+typedef struct presign
+{
+    presign_entry_t *ring;
+    size_t capacity;
+    size_t head;  /**< Oldest entry */
+    size_t count; /**< Entries ready to use */
+    const mklhs_signer_t *signer;
+    char data_set_id[MAX_DATA_SET_ID_LENGTH];
+    char id[MAX_ID_LENGTH];
+    pthread_t producer;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t idle;  /**< Signals that the producer finished hashing a tag */
+    size_t epoch;         /**< Incremented when the key changes */
+    int hashing;          /**< The producer is hashing a tag with signer */
+    int running;
+    int failed;   /**< The producer could not set up RELIC */
+    size_t hits;  /**< Points signed with a precomputed tag */
+    size_t misses; /**< Points signed in full because the ring was empty */
+} presign_t;
+
+/**
+ * @brief Allocates the ring and starts the producer
+ *
+ * @param presign Pointer to the presigner to initialize
+ * @param signer The signer of the key, must stay valid until presign_rekey() or presign_destroy()
+ * @param data_set_id The data set every message is signed for
+ * @param id The identity of the signer
+ * @param capacity Number of precomputed tags to keep ready
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int presign_init(presign_t *presign, const mklhs_signer_t *signer, const char *data_set_id,
+                 const char *id, size_t capacity);
+
+/**
+ * @brief Signs the data points of a message with precomputed tags
+ *
+ * The message's tags are replaced by the precomputed ones. The message must
+ * have the data set and identity the presigner was started with.
+ *
+ * @param presign Pointer to the presigner
+ * @param message Pointer to the message structure containing data points to be signed
+ * @param num_data_points Number of data points to be signed
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int presign_sign_points(presign_t *presign, message_t *message, size_t num_data_points);
+
+/**
+ * @brief Switches to another key and drops the tags precomputed with the old one
+ *
+ * Waits until the producer is done with the tag it is hashing, so the old
+ * signer can be freed once this returns.
+ *
+ * @param presign Pointer to the presigner
+ * @param signer The signer of the new key, must stay valid until the next presign_rekey() or
+ *               presign_destroy()
+ */
+void presign_rekey(presign_t *presign, const mklhs_signer_t *signer);
+
+/**
+ * @brief Stops the producer and frees the ring
+ *
+ * @param presign Pointer to the presigner
+ */
+void presign_destroy(presign_t *presign);
+
+#endif
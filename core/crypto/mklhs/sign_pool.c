@@ -0,0 +1,149 @@
+#include <unistd.h>
+
+#include "sign_pool.h"
+#include "../../utils/utils.h"
+
+// Sign points [from, to) of the message with this thread's context
+static int sign_range(message_t *message, const bn_st *sk, size_t from, size_t to)
+{
+    for (size_t i = from; i < to; i++)
+    {
+        int res_sign = cp_mklhs_sig(message->sigs[i], message->data_points[i], message->data_set_id,
+                                    message->id, message_tag(message, i), sk);
+        if (res_sign != RLC_OK)
+        {
+            fprintf(stderr, "Could not sign message\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *sign_worker_loop(void *arg)
+{
+    sign_worker_t *worker = (sign_worker_t *)arg;
+    sign_pool_t *pool = worker->pool;
+
+    int ready = relic_thread_init(0) == RLC_OK;
+    pthread_mutex_lock(&pool->lock);
+    if (!ready)
+        pool->failed = 1;
+    pool->started++;
+    pthread_cond_signal(&pool->done);
+
+    size_t seen = 0;
+    while (ready)
+    {
+        while (pool->running && pool->generation == seen)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (!pool->running)
+            break;
+        seen = pool->generation;
+
+        message_t *message = pool->message;
+        const bn_st *sk = pool->sk;
+        const mklhs_signer_t *signer = pool->signer;
+        size_t n = pool->num_data_points;
+        size_t from = n * worker->index / pool->num_threads;
+        size_t to = n * (worker->index + 1) / pool->num_threads;
+        pthread_mutex_unlock(&pool->lock);
+
+        int res = signer != NULL ? signer_sign_points(signer, message, from, to)
+                                 : sign_range(message, sk, from, to);
+
+        pthread_mutex_lock(&pool->lock);
+        if (res != 0)
+            pool->failed = 1;
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (ready)
+        relic_thread_cleanup();
+    return NULL;
+}
+
+int sign_pool_init(sign_pool_t *pool, size_t num_threads)
+{
+    if (num_threads == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cores > 0 ? (size_t)cores : 1;
+    }
+    if (num_threads > SIGN_POOL_MAX_THREADS)
+        num_threads = SIGN_POOL_MAX_THREADS;
+
+    memset(pool, 0, sizeof(sign_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->running = 1;
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        sign_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        if (pthread_create(&worker->thread, NULL, sign_worker_loop, worker) != 0)
+        {
+            fprintf(stderr, "Could not start signing thread %zu\n", i);
+            sign_pool_destroy(pool);
+            return -1;
+        }
+        pool->num_threads++;
+    }
+
+    // Wait until every worker has its context
+    pthread_mutex_lock(&pool->lock);
+    while (pool->started < pool->num_threads)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    int failed = pool->failed;
+    pthread_mutex_unlock(&pool->lock);
+    if (failed)
+    {
+        fprintf(stderr, "Could not set up RELIC in the signing threads\n");
+        sign_pool_destroy(pool);
+        return -1;
+    }
+    return 0;
+}
+
+int sign_pool_sign(sign_pool_t *pool, message_t *message, bn_t sk, const mklhs_signer_t *signer,
+                   size_t num_data_points)
+{
+    if (pool == NULL || pool->num_threads <= 1)
+    {
+        if (signer != NULL)
+            return signer_sign_points(signer, message, 0, num_data_points);
+        return sign_data_points(message, sk, num_data_points);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->message = message;
+    pool->sk = sk;
+    pool->signer = signer;
+    pool->num_data_points = num_data_points;
+    pool->failed = 0;
+    pool->pending = pool->num_threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    int failed = pool->failed;
+    pool->message = NULL;
+    pthread_mutex_unlock(&pool->lock);
+    return failed ? -1 : 0;
+}
+
+void sign_pool_destroy(sign_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pool->num_threads = 0;
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file sign_pool.h
+ * @brief Thread pool that signs the data points of a message in parallel
+ *
+ * Every worker owns its own RELIC core context, set up with
+ * relic_thread_init(). A message's points are split into one contiguous
+ * range per worker and the call returns once every range is signed. MKLHS signatures are deterministic, so the
+ * result is bit-identical to sign_data_points(). Workers can sign through
+ * a shared mklhs_signer_t instead of cp_mklhs_sig().
+ */
+#ifndef SIGN_POOL_H
+#define SIGN_POOL_H
+
+#include <pthread.h>
+
+#include "signer.h"
+
+#define SIGN_POOL_MAX_THREADS 64
+
+struct sign_pool;
+
+/**
+ * @brief A worker and the share of each message it signs
+ */
+typedef struct sign_worker
+{
+    struct sign_pool *pool;
+    size_t index; /**< Signs the index-th of num_threads ranges */
+    pthread_t thread;
+} sign_worker_t;
+
+/**
+ * @brief The workers and the message they are signing
+ */
+typedef struct sign_pool
+{
+    sign_worker_t workers[SIGN_POOL_MAX_THREADS];
+    size_t num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /**< Signals a new job or shutdown to the workers */
+    pthread_cond_t done;    /**< Signals the caller that the last worker finished */
+    size_t generation;      /**< Incremented for every job */
+    size_t pending;         /**< Workers still signing the current job */
+    size_t started;         /**< Workers that have set up their RELIC context */
+    int failed;             /**< A worker failed to sign or to start */
+    int running;
+
+    /* Current job */
+    message_t *message;
+    const bn_st *sk;
+    const mklhs_signer_t *signer;
+    size_t num_data_points;
+} sign_pool_t;
+
+/**
+ * @brief Starts the signing workers
+ *
+ * @param pool Pointer to the pool to initialize
+ * @param num_threads Number of workers, 0 for one per online core
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int sign_pool_init(sign_pool_t *pool, size_t num_threads);
+
+/**
+ * @brief Signs the data points of a message across the workers
+ *
+ * @param pool Pointer to the pool
+ * @param message Pointer to the message structure containing data points to be signed
+ * @param sk Secret key used for signing the data points
+ * @param signer Precomputed tables of sk to sign with, NULL to use cp_mklhs_sig()
+ * @param num_data_points Number of data points to be signed
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int sign_pool_sign(sign_pool_t *pool, message_t *message, bn_t sk, const mklhs_signer_t *signer,
+                   size_t num_data_points);
+
+/**
+ * @brief Stops the workers and cleans up their RELIC contexts
+ *
+ * @param pool Pointer to the pool
+ */
+void sign_pool_destroy(sign_pool_t *pool);
+
+#endif
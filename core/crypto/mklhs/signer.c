@@ -0,0 +1,136 @@
+#include "signer.h"
+
+int signer_init(mklhs_signer_t *signer, bn_t sk)
+{
+    int result = 0;
+    bn_null(signer->sk);
+    g1_null(signer->sk_g);
+    RLC_TRY
+    {
+        bn_new(signer->sk);
+        g1_new(signer->sk_g);
+        for (int i = 0; i < RLC_G1_TABLE; i++)
+        {
+            g1_null(signer->comb[i]);
+            g1_new(signer->comb[i]);
+        }
+        for (int i = 0; i < SIGNER_SMALL_MAX; i++)
+        {
+            g1_null(signer->small[i]);
+            g1_new(signer->small[i]);
+        }
+
+        bn_copy(signer->sk, sk);
+        g1_mul_gen(signer->sk_g, sk);
+        g1_mul_pre(signer->comb, signer->sk_g);
+
+        // small[m] = small[m - 1] + sk·G, normalized together so lookups add in affine form
+        g1_set_infty(signer->small[0]);
+        g1_copy(signer->small[1], signer->sk_g);
+        for (int i = 2; i < SIGNER_SMALL_MAX; i++)
+            g1_add(signer->small[i], signer->small[i - 1], signer->sk_g);
+        g1_norm_sim(signer->small + 1, (const g1_t *)(signer->small + 1), SIGNER_SMALL_MAX - 1);
+    }
+    RLC_CATCH_ANY
+    {
+        fprintf(stderr, "Could not precompute signing tables\n");
+        result = -1;
+    }
+    return result;
+}
+
+int signer_hash(const mklhs_signer_t *signer, g1_t h, const char *data, const char *id,
+                const char *tag)
+{
+    // Hash the same string cp_mklhs_sig() does: data || id || tag
+    size_t data_len = strlen(data);
+    size_t id_len = strlen(id);
+    size_t tag_len = strlen(tag);
+    uint8_t str[MAX_DATA_SET_ID_LENGTH + MAX_ID_LENGTH + MAX_TAG_LENGTH];
+    if (data_len + id_len + tag_len > sizeof(str))
+        return -1;
+    memcpy(str, data, data_len);
+    memcpy(str + data_len, id, id_len);
+    memcpy(str + data_len + id_len, tag, tag_len);
+
+    int result = 0;
+    RLC_TRY
+    {
+        g1_map(h, str, data_len + id_len + tag_len);
+        g1_mul_key(h, h, signer->sk);
+    }
+    RLC_CATCH_ANY
+    {
+        result = -1;
+    }
+    return result;
+}
+
+int signer_finish(const mklhs_signer_t *signer, g1_t s, const g1_t h, const bn_t m)
+{
+    int result = 0;
+    g1_t a;
+    g1_null(a);
+    RLC_TRY
+    {
+        g1_new(a);
+        // m·(sk·G) from the tables instead of a second multiplication
+        dig_t digit = 0;
+        int small = bn_sign(m) == RLC_POS && bn_bits(m) <= RLC_DIG;
+        if (small)
+        {
+            bn_get_dig(&digit, m);
+            small = digit < SIGNER_SMALL_MAX;
+        }
+        if (small)
+        {
+            g1_add(s, h, signer->small[digit]);
+        }
+        else
+        {
+            g1_mul_fix(a, signer->comb, m);
+            g1_add(s, h, a);
+        }
+    }
+    RLC_CATCH_ANY
+    {
+        result = -1;
+    }
+    RLC_FINALLY
+    {
+        g1_free(a);
+    }
+    return result;
+}
+
+int signer_sign(const mklhs_signer_t *signer, g1_t s, const bn_t m, const char *data,
+                const char *id, const char *tag)
+{
+    if (signer_hash(signer, s, data, id, tag) != 0)
+        return -1;
+    return signer_finish(signer, s, s, m);
+}
+
+int signer_sign_points(const mklhs_signer_t *signer, message_t *message, size_t from, size_t to)
+{
+    for (size_t i = from; i < to; i++)
+    {
+        if (signer_sign(signer, message->sigs[i], message->data_points[i], message->data_set_id,
+                        message->id, message_tag(message, i)) != 0)
+        {
+            fprintf(stderr, "Could not sign message\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void signer_free(mklhs_signer_t *signer)
+{
+    bn_free(signer->sk);
+    g1_free(signer->sk_g);
+    for (int i = 0; i < RLC_G1_TABLE; i++)
+        g1_free(signer->comb[i]);
+    for (int i = 0; i < SIGNER_SMALL_MAX; i++)
+        g1_free(signer->small[i]);
+}
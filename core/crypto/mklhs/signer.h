@@ -0,0 +1,107 @@
+/**
+ * @file signer.h
+ * @brief MKLHS signer with precomputed per-key tables
+ *
+ * cp_mklhs_sig() computes s = sk·(H(data||id||tag) + m·G), which costs two
+ * scalar multiplications per point. By linearity s = sk·H(...) + m·(sk·G),
+ * and sk·G only depends on the key. The signer computes sk·G once per key,
+ * keeps the multiples 0·(sk·G) .. (SIGNER_SMALL_MAX-1)·(sk·G) for the small
+ * data points the client generates, and a fixed-base comb table for larger
+ * ones. Signing a point then takes one scalar multiplication plus a table
+ * lookup and a point addition. The signatures are the same points as with
+ * cp_mklhs_sig(), so their encoding is bit-identical.
+ *
+ * @note A signer is read-only after signer_init() and may be shared by threads.
+ */
+#ifndef SIGNER_H
+#define SIGNER_H
+
+#include "mklhs.h"
+
+#define SIGNER_SMALL_MAX 64
+
+/**
+ * @brief Per-key tables of the signer
+ */
+typedef struct mklhs_signer
+{
+    bn_t sk;                       /**< Copy of the secret key */
+    g1_t sk_g;                     /**< sk·G */
+    g1_t comb[RLC_G1_TABLE];       /**< Fixed-base table of sk·G for large m */
+    g1_t small[SIGNER_SMALL_MAX];  /**< small[m] = m·(sk·G), normalized */
+} mklhs_signer_t;
+
+/**
+ * @brief Precomputes the tables of a key
+ *
+ * @param signer Pointer to the signer to initialize
+ * @param sk Secret key the signer signs with
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int signer_init(mklhs_signer_t *signer, bn_t sk);
+
+/**
+ * @brief Computes the value-independent part sk·H(data||id||tag) of a signature
+ *
+ * @param signer Pointer to the signer
+ * @param h Output point
+ * @param data The data set identifier
+ * @param id The identity of the signer
+ * @param tag The tag of the data point
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int signer_hash(const mklhs_signer_t *signer, g1_t h, const char *data, const char *id,
+                const char *tag);
+
+/**
+ * @brief Completes a signature from its hashed part, s = h + m·(sk·G)
+ *
+ * The signature is left in projective form, encode_signatures() normalizes
+ * all points of a message together.
+ *
+ * @param signer Pointer to the signer
+ * @param s Output signature, may be the same point as h
+ * @param h The point from signer_hash()
+ * @param m The data point
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int signer_finish(const mklhs_signer_t *signer, g1_t s, const g1_t h, const bn_t m);
+
+/**
+ * @brief Signs one data point, same result as cp_mklhs_sig()
+ *
+ * @param signer Pointer to the signer
+ * @param s Output signature
+ * @param m The data point
+ * @param data The data set identifier
+ * @param id The identity of the signer
+ * @param tag The tag of the data point
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int signer_sign(const mklhs_signer_t *signer, g1_t s, const bn_t m, const char *data,
+                const char *id, const char *tag);
+
+/**
+ * @brief Signs a range of the data points in a message
+ *
+ * @param signer Pointer to the signer
+ * @param message Pointer to the message structure containing data points to be signed
+ * @param from Index of the first point to sign
+ * @param to Index after the last point to sign
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int signer_sign_points(const mklhs_signer_t *signer, message_t *message, size_t from, size_t to);
+
+/**
+ * @brief Frees the tables of a signer
+ *
+ * @param signer Pointer to the signer
+ */
+void signer_free(mklhs_signer_t *signer);
+
+#endif
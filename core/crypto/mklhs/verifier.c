@@ -0,0 +1,257 @@
+#include <time.h>
+#include "verifier.h"
+#include "../../utils/utils.h"
+
+static uint64_t verifier_clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Uniform in [0, 1)
+static double verifier_random(verifier_t *verifier)
+{
+    uint64_t x = verifier->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    verifier->rng = x;
+    return (x >> 11) * 0x1.0p-53;
+}
+
+// Set the rate so the next window costs about budget of a core, called with the lock held
+static void verifier_adapt(verifier_t *verifier)
+{
+    uint64_t now = verifier_clock_ns(CLOCK_MONOTONIC);
+    uint64_t wall_ns = now - verifier->window_start_ns;
+    if (wall_ns < (uint64_t)VERIFIER_WINDOW_MS * 1000000)
+        return;
+    if (verifier->window_verified > 0 && verifier->window_offered > 0)
+    {
+        double cost_ns = (double)verifier->window_cpu_ns / verifier->window_verified;
+        double affordable = verifier->budget * wall_ns / cost_ns;
+        verifier->rate = affordable / verifier->window_offered;
+    }
+    else
+    {
+        verifier->rate *= 2;
+    }
+    if (verifier->rate > verifier->max_rate)
+        verifier->rate = verifier->max_rate;
+    if (verifier->rate < VERIFIER_MIN_RATE)
+        verifier->rate = VERIFIER_MIN_RATE;
+    verifier->window_start_ns = now;
+    verifier->window_cpu_ns = 0;
+    verifier->window_offered = 0;
+    verifier->window_verified = 0;
+}
+
+// Returns 1 if the signature on the wire verifies
+static int verifier_check(const verifier_sample_t *sample, g1_t sig, bn_t mu[], g2_t pk[])
+{
+    uint8_t bin[RLC_FP_BYTES + 1];
+    int len = base64_dec(sample->sig_b64, strlen(sample->sig_b64), bin, sizeof(bin));
+    if (len <= 0)
+        return 0;
+
+    int valid = 0;
+    RLC_TRY
+    {
+        g1_read_bin(sig, bin, len);
+        bn_copy(mu[0], sample->m);
+        g2_copy(pk[0], sample->pk);
+        // A single point is the identity function of itself
+        dig_t one = 1;
+        const dig_t *f[1] = {&one};
+        size_t flen[1] = {1};
+        const char *ids[1] = {sample->id};
+        const char *tags[1] = {sample->tag};
+        valid = cp_mklhs_ver(sig, sample->m, (const bn_t *)mu, sample->data_set_id, ids, tags,
+                             f, flen, (const g2_t *)pk, 1) == 1;
+    }
+    RLC_CATCH_ANY
+    {
+        valid = 0;
+    }
+    return valid;
+}
+
+static void *verifier_loop(void *arg)
+{
+    verifier_t *verifier = (verifier_t *)arg;
+
+    // Verification is a background check, the send path comes first
+    int ready = relic_thread_init(1) == RLC_OK;
+
+    verifier_sample_t sample;
+    g1_t sig;
+    bn_t mu[1];
+    g2_t pk[1];
+    bn_null(sample.m);
+    g2_null(sample.pk);
+    g1_null(sig);
+    bn_null(mu[0]);
+    g2_null(pk[0]);
+    bn_new(sample.m);
+    g2_new(sample.pk);
+    g1_new(sig);
+    bn_new(mu[0]);
+    g2_new(pk[0]);
+    pthread_mutex_lock(&verifier->lock);
+    if (!ready)
+    {
+        verifier->failed = 1;
+        fprintf(stderr, "Could not set up RELIC in the verifier thread\n");
+    }
+    while (ready && verifier->running)
+    {
+        if (verifier->count == 0)
+        {
+            pthread_cond_wait(&verifier->not_empty, &verifier->lock);
+            continue;
+        }
+        verifier_sample_t *entry = &verifier->ring[verifier->head];
+        bn_copy(sample.m, entry->m);
+        g2_copy(sample.pk, entry->pk);
+        memcpy(sample.sig_b64, entry->sig_b64, sizeof(sample.sig_b64));
+        memcpy(sample.data_set_id, entry->data_set_id, sizeof(sample.data_set_id));
+        memcpy(sample.id, entry->id, sizeof(sample.id));
+        memcpy(sample.tag, entry->tag, sizeof(sample.tag));
+        verifier->head = (verifier->head + 1) % verifier->capacity;
+        verifier->count--;
+        pthread_mutex_unlock(&verifier->lock);
+
+        uint64_t start = verifier_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        int valid = verifier_check(&sample, sig, mu, pk);
+        uint64_t cpu_ns = verifier_clock_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+        if (!valid)
+            fprintf(stderr, "Signature of tag %s does not verify\n", sample.tag);
+
+        pthread_mutex_lock(&verifier->lock);
+        verifier->verified++;
+        verifier->window_verified++;
+        verifier->window_cpu_ns += cpu_ns;
+        if (!valid)
+            verifier->mismatches++;
+        verifier_adapt(verifier);
+    }
+    pthread_mutex_unlock(&verifier->lock);
+    bn_free(sample.m);
+    g2_free(sample.pk);
+    g1_free(sig);
+    bn_free(mu[0]);
+    g2_free(pk[0]);
+    if (ready)
+        relic_thread_cleanup();
+    return NULL;
+}
+
+int verifier_init(verifier_t *verifier, double rate, double budget)
+{
+    if (rate <= 0 || rate > 1 || budget <= 0)
+    {
+        fprintf(stderr, "Invalid verifier configuration\n");
+        return -1;
+    }
+    memset(verifier, 0, sizeof(verifier_t));
+    verifier->ring = (verifier_sample_t *)calloc(VERIFIER_CAPACITY, sizeof(verifier_sample_t));
+    if (verifier->ring == NULL)
+    {
+        fprintf(stderr, "Could not allocate verifier queue\n");
+        return -1;
+    }
+    for (size_t i = 0; i < VERIFIER_CAPACITY; i++)
+    {
+        bn_null(verifier->ring[i].m);
+        g2_null(verifier->ring[i].pk);
+        bn_new(verifier->ring[i].m);
+        g2_new(verifier->ring[i].pk);
+    }
+    // The decoding table is shared, build it before the thread reads it
+    base64_build_dectable();
+    verifier->capacity = VERIFIER_CAPACITY;
+    verifier->rate = rate;
+    verifier->max_rate = rate;
+    verifier->budget = budget;
+    verifier->rng = verifier_clock_ns(CLOCK_MONOTONIC) | 1;
+    verifier->window_start_ns = verifier_clock_ns(CLOCK_MONOTONIC);
+    pthread_mutex_init(&verifier->lock, NULL);
+    pthread_cond_init(&verifier->not_empty, NULL);
+    verifier->running = 1;
+    if (pthread_create(&verifier->thread, NULL, verifier_loop, verifier) != 0)
+    {
+        fprintf(stderr, "Could not start verifier thread\n");
+        verifier->running = 0;
+        pthread_cond_destroy(&verifier->not_empty);
+        pthread_mutex_destroy(&verifier->lock);
+        free(verifier->ring);
+        verifier->ring = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void verifier_offer(verifier_t *verifier, message_t *message, char *sigs_b64[],
+                    size_t num_data_points, g2_t pk)
+{
+    pthread_mutex_lock(&verifier->lock);
+    verifier->offered += num_data_points;
+    verifier->window_offered += num_data_points;
+    int queued = 0;
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (verifier_random(verifier) >= verifier->rate)
+            continue;
+        if (verifier->count == verifier->capacity ||
+            strlen(sigs_b64[i]) >= sizeof(verifier->ring[0].sig_b64))
+        {
+            verifier->dropped++;
+            continue;
+        }
+        verifier_sample_t *entry =
+            &verifier->ring[(verifier->head + verifier->count) % verifier->capacity];
+        bn_copy(entry->m, message->data_points[i]);
+        g2_copy(entry->pk, pk);
+        bad_strncpy(entry->sig_b64, sigs_b64[i], sizeof(entry->sig_b64));
+        bad_strncpy(entry->data_set_id, message->data_set_id, sizeof(entry->data_set_id));
+        bad_strncpy(entry->id, message->id, sizeof(entry->id));
+        bad_strncpy(entry->tag, message_tag(message, i), sizeof(entry->tag));
+        verifier->count++;
+        verifier->sampled++;
+        queued = 1;
+    }
+    if (queued)
+        pthread_cond_signal(&verifier->not_empty);
+    pthread_mutex_unlock(&verifier->lock);
+}
+
+void verifier_report(verifier_t *verifier, FILE *out)
+{
+    pthread_mutex_lock(&verifier->lock);
+    fprintf(out, "Verified %zu of %zu points (%zu sampled, %zu dropped), %zu mismatches, "
+                 "sampling rate %.4f\n",
+            verifier->verified, verifier->offered, verifier->sampled, verifier->dropped,
+            verifier->mismatches, verifier->rate);
+    pthread_mutex_unlock(&verifier->lock);
+}
+
+void verifier_destroy(verifier_t *verifier)
+{
+    if (verifier->ring == NULL)
+        return;
+    pthread_mutex_lock(&verifier->lock);
+    verifier->running = 0;
+    pthread_cond_signal(&verifier->not_empty);
+    pthread_mutex_unlock(&verifier->lock);
+    pthread_join(verifier->thread, NULL);
+    pthread_cond_destroy(&verifier->not_empty);
+    pthread_mutex_destroy(&verifier->lock);
+    for (size_t i = 0; i < verifier->capacity; i++)
+    {
+        bn_free(verifier->ring[i].m);
+        g2_free(verifier->ring[i].pk);
+    }
+    free(verifier->ring);
+    verifier->ring = NULL;
+}
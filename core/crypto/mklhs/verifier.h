@@ -0,0 +1,115 @@
+/**
+ * @file verifier.h
+ * @brief Sampled background verification of outgoing signatures
+ *
+ * A random sample of the signed data points is handed to a low-priority
+ * thread together with the base64 signature that goes on the wire. The
+ * thread decodes each signature and checks it with cp_mklhs_ver(), so a
+ * corrupted signature shows up in the mismatch counter before the server
+ * rejects it. Offering points never blocks: when the queue is full the
+ * sample is dropped.
+ *
+ * Verification needs pairings and costs several times as much as signing.
+ * The thread measures its own CPU time and adjusts the sampling rate once
+ * per VERIFIER_WINDOW_MS, so verification stays within the CPU budget. The
+ * configured rate is the upper bound.
+ */
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "mklhs.h"
+
+#define VERIFIER_CAPACITY 256
+#define VERIFIER_DEFAULT_BUDGET 0.05 /* Fraction of one core */
+#define VERIFIER_MIN_RATE 0.0001
+#define VERIFIER_WINDOW_MS 1000
+#define VERIFIER_SIG_B64_SIZE (4 * ((RLC_FP_BYTES + 1 + 2) / 3) + 1)
+
+/**
+ * @brief A signed data point waiting to be verified
+ */
+typedef struct verifier_sample
+{
+    bn_t m;
+    g2_t pk;
+    char sig_b64[VERIFIER_SIG_B64_SIZE];
+    char data_set_id[MAX_DATA_SET_ID_LENGTH];
+    char id[MAX_ID_LENGTH];
+    char tag[MAX_TAG_LENGTH];
+} verifier_sample_t;
+
+/**
+ * @brief The sample queue, its thread and the counters
+ */
+typedef struct verifier
+{
+    verifier_sample_t *ring;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    int running;
+    int failed;        /**< The thread could not set up RELIC */
+    uint64_t rng;      /**< xorshift state for sampling */
+    double rate;       /**< Current probability that a point is sampled */
+    double max_rate;   /**< Configured sampling rate */
+    double budget;     /**< CPU time allowed for verification, as a fraction of one core */
+
+    /* Counters */
+    size_t offered;    /**< Points offered for sampling */
+    size_t sampled;    /**< Points queued for verification */
+    size_t dropped;    /**< Sampled points dropped because the queue was full */
+    size_t verified;   /**< Points checked */
+    size_t mismatches; /**< Points whose signature did not verify */
+
+    /* Current adaptation window */
+    uint64_t window_start_ns;
+    uint64_t window_cpu_ns;
+    size_t window_offered;
+    size_t window_verified;
+} verifier_t;
+
+/**
+ * @brief Starts the verifier thread
+ *
+ * @param verifier Pointer to the verifier to initialize
+ * @param rate Fraction of the points to verify at most, between 0 and 1
+ * @param budget CPU time to spend on verification, as a fraction of one core
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int verifier_init(verifier_t *verifier, double rate, double budget);
+
+/**
+ * @brief Offers the signed points of a message for verification
+ *
+ * @param verifier Pointer to the verifier
+ * @param message The signed message
+ * @param sigs_b64 The base64 signatures as they are sent
+ * @param num_data_points Number of data points in the message
+ * @param pk Public key of the signer
+ */
+void verifier_offer(verifier_t *verifier, message_t *message, char *sigs_b64[],
+                    size_t num_data_points, g2_t pk);
+
+/**
+ * @brief Prints the counters
+ *
+ * @param verifier Pointer to the verifier
+ * @param out Stream to print to
+ */
+void verifier_report(verifier_t *verifier, FILE *out);
+
+/**
+ * @brief Stops the thread and frees the queue, samples still queued are not verified
+ *
+ * @param verifier Pointer to the verifier
+ */
+void verifier_destroy(verifier_t *verifier);
+
+#endif
@@ -1,18 +1,31 @@
 #include "message.h"
 
+// Maps random bytes in place to "0-9a-zA-Z". Multiply-shift instead of a modulo or
+// a table lookup keeps the loop branch-free, so it vectorizes
+static void rand_alnum(uint8_t *buf, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t x = (uint8_t)((buf[i] * 62) >> 8);
+        buf[i] = (uint8_t)('0' + x + (x >= 10) * ('a' - '0' - 10) + (x >= 36) * ('A' - 'a' - 26));
+    }
+}
+
 // Random string
 void rand_str(char *dest, size_t length)
 {
-    char charset[] = "0123456789"
-                     "abcdefghijklmnopqrstuvwxyz"
-                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    rand_bytes((uint8_t *)dest, length);
+    rand_alnum((uint8_t *)dest, length);
+    dest[length] = '\0';
+}
 
-    while (length-- > 0)
-    {
-        size_t index = (double)rand() / RAND_MAX * (sizeof charset - 1);
-        *dest++ = charset[index];
-    }
-    *dest = '\0';
+void rand_tags(char *tags, size_t count, size_t size)
+{
+    // One draw for all tags, the terminators are overwritten afterwards
+    rand_bytes((uint8_t *)tags, count * size);
+    rand_alnum((uint8_t *)tags, count * size);
+    for (size_t i = 1; i <= count; i++)
+        tags[i * size - 1] = '\0';
 }
 
 int init_message(message_t *message, dig_t data_points[],
@@ -23,71 +36,121 @@ int init_message(message_t *message, dig_t data_points[],
         fprintf(stderr, "Message pointer is NULL\n");
         return -1;
     }
+    memset(message, 0, sizeof(message_t));
+    if (num_data_points == 0 || num_data_points > MAX_DATA_POINTS)
+    {
+        fprintf(stderr, "Number of data points must be between 1 and %d\n", MAX_DATA_POINTS);
+        return -1;
+    }
+    message->data_points = (bn_t *)calloc(num_data_points, sizeof(bn_t));
+    message->sigs = (g1_t *)calloc(num_data_points, sizeof(g1_t));
+    message->tag_offsets = (uint32_t *)calloc(num_data_points, sizeof(uint32_t));
+    message->tags = (char *)calloc(num_data_points, MAX_TAG_LENGTH);
+    if (message->data_points == NULL || message->sigs == NULL ||
+        message->tag_offsets == NULL || message->tags == NULL)
+    {
+        fprintf(stderr, "Could not allocate message of %zu data points\n", num_data_points);
+        cleanup_message(message);
+        return -1;
+    }
+    message->capacity = num_data_points;
     for (int i = 0; i < num_data_points; i++)
     {
         bn_null(message->data_points[i]);
         bn_new(message->data_points[i]);
-        bn_set_dig(message->data_points[i], data_points[i]);
 
         // Initialize signature
         g1_null(message->sigs[i]);
         g1_new(message->sigs[i]);
+    }
+    return reset_message(message, data_points, num_data_points);
+}
 
-        // Geneterate random strings not using UUID
-        char tag_str[MAX_ID_LENGTH];
-        rand_str(tag_str, MAX_ID_LENGTH - 1);
-        bad_strncpy(message->tags[i], tag_str, sizeof(message->tags[i]));
+int reset_message(message_t *message, dig_t data_points[], size_t num_data_points)
+{
+    if (message == NULL)
+    {
+        fprintf(stderr, "Message pointer is NULL\n");
+        return -1;
+    }
+    if (num_data_points > message->capacity)
+    {
+        fprintf(stderr, "Message has room for %zu data points, not %zu\n", message->capacity,
+                num_data_points);
+        return -1;
     }
+    message->num_data_points = num_data_points;
+    for (int i = 0; i < num_data_points; i++)
+    {
+        bn_set_dig(message->data_points[i], data_points[i]);
+        message->tag_offsets[i] = i * MAX_TAG_LENGTH;
+    }
+    // Geneterate random strings not using UUID
+    rand_tags(message->tags, num_data_points, MAX_TAG_LENGTH);
     // Device id
-    bad_strncpy(message->ids[0], DEVICE_ID, sizeof(DEVICE_ID));
+    bad_strncpy(message->id, DEVICE_ID, sizeof(message->id));
     // Set data_set_id
     bad_strncpy(message->data_set_id, TEST_DATABASE, sizeof(message->data_set_id));
 
     return 0;
 }
+
+char *message_tag(const message_t *message, size_t i)
+{
+    return message->tags + message->tag_offsets[i];
+}
+
 void print_message(message_t *msg)
 {
-    for (int i = 0; i < NUM_DATA_POINTS; i++)
+    printf("ID: %s\n", msg->id);
+    for (int i = 0; i < msg->num_data_points; i++)
     {
         printf("Data point: %d\n", i);
         bn_print(msg->data_points[i]);
         printf("Signature: %d\n", i);
         g1_print(msg->sigs[i]);
-        printf("ID: %s\n", msg->ids[i]);
-        printf("Tag: %s\n", msg->tags[i]);
+        printf("Tag: %s\n", message_tag(msg, i));
     }
     printf("Data set id: %s\n", msg->data_set_id);
 }
-void cleanup_message(message_t *message, size_t num_data_points)
+void cleanup_message(message_t *message)
 {
     if (message == NULL)
         return;
 
-    for (size_t i = 0; i < num_data_points; i++)
+    for (size_t i = 0; i < message->capacity; i++)
     {
         bn_free(message->data_points[i]);
         g1_free(message->sigs[i]);
     }
+    free(message->data_points);
+    free(message->sigs);
+    free(message->tag_offsets);
+    free(message->tags);
+    memset(message, 0, sizeof(message_t));
 }
 int gen_dig_data_points(dig_t data_points[], size_t num_data_points)
 {
-    srand(time(NULL));
     int range = 40;
     int min = 2;
+    rand_bytes((uint8_t *)data_points, num_data_points * sizeof(dig_t));
+    // Map 16 random bits of each draw onto [min, min + range)
     for (int i = 0; i < num_data_points; i++)
     {
-        data_points[i] = (dig_t)(rand() % range + min);
+        data_points[i] = (dig_t)(((data_points[i] & 0xFFFF) * range >> 16) + min);
     }
     return 0;
 }
 int gen_float_data_points(double data_points[], size_t num_data_points)
 {
-    srand(time(NULL));
     float a = 35.0;
+    rand_bytes((uint8_t *)data_points, num_data_points * sizeof(double));
     // Generate random float data points from 0 to 35
     for (int i = 0; i < num_data_points; i++)
     {
-        data_points[i] = ((double)rand() / (double)RAND_MAX) * a;
+        uint64_t bits;
+        memcpy(&bits, &data_points[i], sizeof(bits));
+        data_points[i] = (bits >> 11) * 0x1.0p-53 * a;
     }
     return 0;
 }
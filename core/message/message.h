@@ -8,60 +8,111 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <stdint.h>
 #include <relic/relic.h>
 #include "../utils/bad_string.h"
 
 #define FUNC "doubling"
 #define DEVICE_ID "12345"
 #define TEST_DATABASE "test.db"
-#define NUM_DATA_POINTS 30
+#define NUM_DATA_POINTS 30 /* Default, the client takes -n */
+#define MAX_DATA_POINTS 65536
 #define NUM_MESSAGES 1
 #define MAX_ID_LENGTH 37
 #define MAX_TAG_LENGTH 37
 #define MAX_DATA_SET_ID_LENGTH 37
 #define MAX_SIGNATURE_LENGTH 128
+#define MAX_SIGNATURE_B64_LENGTH (4 * ((MAX_SIGNATURE_LENGTH + 2) / 3) + 1)
 
 /**
  * @brief Structure representing a message containing data points, signatures, and associated metadata
  *
- * This structure holds an array of data points along with their corresponding signatures,
- * identifiers, tags, and a dataset identifier. It is used for message transmission and
- * storage in the system.
+ * The message is sized when it is initialized and stored as structure of arrays:
+ * the values, the signatures and the tags each sit in one array, and the device
+ * id and dataset identifier are stored once for all points. The tags are packed
+ * back to back in one buffer, tag i starts at tag_offsets[i].
  *
- * @note The size of arrays is determined by preprocessor constants:
- *       NUM_DATA_POINTS: Number of data points in the message
- *       MAX_ID_LENGTH: Maximum length of each ID string
- *       MAX_TAG_LENGTH: Maximum length of each tag string
- *       MAX_DATA_SET_ID_LENGTH: Maximum length of dataset ID string
+ * @note MAX_TAG_LENGTH, MAX_ID_LENGTH and MAX_DATA_SET_ID_LENGTH bound the
+ *       strings including their terminator.
  */
 typedef struct message
 {
-    bn_t data_points[NUM_DATA_POINTS];
-    g1_t sigs[NUM_DATA_POINTS];
-    char ids[NUM_DATA_POINTS][MAX_ID_LENGTH];
-    char tags[NUM_DATA_POINTS][MAX_TAG_LENGTH];
+    size_t num_data_points;  /**< Points in the current batch */
+    size_t capacity;         /**< Points the arrays were allocated for */
+    bn_t *data_points;       /**< Values */
+    g1_t *sigs;              /**< Signature of each value */
+    uint32_t *tag_offsets;   /**< Start of each tag in tags */
+    char *tags;              /**< NUL-terminated tags, packed */
+    char id[MAX_ID_LENGTH];  /**< Device id, shared by all points */
     char data_set_id[MAX_DATA_SET_ID_LENGTH];
 } message_t;
 
+/**
+ * @brief Fills a buffer with a random alphanumeric string
+ *
+ * Uses RELIC's generator, so the calling thread needs a RELIC context.
+ *
+ * @param dest Buffer of at least length + 1 bytes
+ * @param length Number of characters to generate
+ */
+void rand_str(char *dest, size_t length);
+
+/**
+ * @brief Fills count packed strings with random alphanumeric characters
+ *
+ * All strings come from one call to RELIC's generator. String i starts at
+ * tags + i * size and has size - 1 characters and a terminator.
+ *
+ * @param tags Buffer of count * size bytes
+ * @param count Number of strings
+ * @param size Size of each string including its terminator, at least 1
+ */
+void rand_tags(char *tags, size_t count, size_t size);
+
 /**
  * @brief Initializes a message structure with data points
  *
+ * Allocates room for num_data_points points, later batches reuse it through
+ * reset_message(). Free the message with cleanup_message().
+ *
  * @param message Pointer to the message structure to initialize
  * @param data_points Array containing the data points to be stored in the message
- * @param num_data_points Number of data points in the array
+ * @param num_data_points Number of data points in the array, at most MAX_DATA_POINTS
  *
  * @return int Returns 0 on success, negative value on error
  */
 int init_message(message_t *message, dig_t data_points[],
                  size_t num_data_points);
 
+/**
+ * @brief Gives an initialized message new data points and tags
+ *
+ * The RELIC objects of the message are reused, so nothing is allocated.
+ *
+ * @param message Pointer to a message set up with init_message()
+ * @param data_points Array containing the data points to be stored in the message
+ * @param num_data_points Number of data points in the array, at most the capacity of the message
+ *
+ * @return int Returns 0 on success, negative value on error
+ */
+int reset_message(message_t *message, dig_t data_points[], size_t num_data_points);
+
+/**
+ * @brief Returns tag i of a message
+ *
+ * @param message Pointer to the message
+ * @param i Index of the data point
+ *
+ * @return The NUL-terminated tag
+ */
+char *message_tag(const message_t *message, size_t i);
+
 /**
  * @brief Cleans up and frees resources associated with a message structure
  *
  * @param message Pointer to the message structure to clean up
- * @param num_data_points Number of data points in the message to clean up
  */
-void cleanup_message(message_t *message, size_t num_data_points);
+void cleanup_message(message_t *message);
 
 /**
  * @brief Prints the contents of a message structure neatly
@@ -71,7 +122,7 @@ void cleanup_message(message_t *message, size_t num_data_points);
 void print_message(message_t *msg);
 
 /**
- * @brief Generates an array of random dig_t numbers between 2 and 40.
+ * @brief Generates an array of random dig_t numbers between 2 and 41 with RELIC's generator
  *
  * @param data_points Array to store the generated random float values
  * @param num_data_points Number of random values to generate
@@ -81,7 +132,7 @@ void print_message(message_t *msg);
 
 int gen_dig_data_points(dig_t data_points[], size_t num_data_points);
 /**
- * @brief Generates an array of random floating-point numbers between 0 and 35.0
+ * @brief Generates an array of random floating-point numbers between 0 and 35.0 with RELIC's generator
  *
  * @param data_points Array where the generated random values will be stored
  * @param num_data_points Number of random values to generate
@@ -0,0 +1,93 @@
+#include "message_pool.h"
+
+static int message_slot_init(message_slot_t *slot, size_t num_data_points)
+{
+    slot->data_points = (dig_t *)calloc(num_data_points, sizeof(dig_t));
+    slot->sig_bin = (unsigned char *)malloc(num_data_points * MAX_SIGNATURE_LENGTH);
+    slot->sig_b64 = (char *)malloc(num_data_points * MAX_SIGNATURE_B64_LENGTH);
+    slot->master = (unsigned char **)calloc(num_data_points, sizeof(unsigned char *));
+    slot->master_decoded = (char **)calloc(num_data_points, sizeof(char *));
+    if (slot->data_points == NULL || slot->sig_bin == NULL || slot->sig_b64 == NULL ||
+        slot->master == NULL || slot->master_decoded == NULL)
+    {
+        fprintf(stderr, "Could not allocate message buffers\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        slot->master[i] = slot->sig_bin + i * MAX_SIGNATURE_LENGTH;
+        slot->master_decoded[i] = slot->sig_b64 + i * MAX_SIGNATURE_B64_LENGTH;
+    }
+    return init_message(&slot->message, slot->data_points, num_data_points);
+}
+
+static void message_slot_free(message_slot_t *slot)
+{
+    // calloc left the message of a slot that was never set up zeroed
+    cleanup_message(&slot->message);
+    free(slot->data_points);
+    free(slot->sig_bin);
+    free(slot->sig_b64);
+    free(slot->master);
+    free(slot->master_decoded);
+}
+
+int message_pool_init(message_pool_t *pool, size_t capacity, size_t num_data_points)
+{
+    memset(pool, 0, sizeof(message_pool_t));
+    if (capacity == 0)
+    {
+        fprintf(stderr, "Message pool needs at least one slot\n");
+        return -1;
+    }
+    pool->slots = (message_slot_t *)calloc(capacity, sizeof(message_slot_t));
+    if (pool->slots == NULL)
+    {
+        fprintf(stderr, "Could not allocate message pool\n");
+        return -1;
+    }
+    pool->capacity = capacity;
+    pool->num_data_points = num_data_points;
+    // Push in reverse so slots are handed out in order
+    for (size_t s = capacity; s-- > 0;)
+    {
+        message_slot_t *slot = &pool->slots[s];
+        if (message_slot_init(slot, num_data_points) != 0)
+        {
+            message_pool_destroy(pool);
+            return -1;
+        }
+        slot->next = pool->free_list;
+        pool->free_list = slot;
+    }
+    return 0;
+}
+
+message_slot_t *message_pool_acquire(message_pool_t *pool)
+{
+    message_slot_t *slot = pool->free_list;
+    if (slot == NULL)
+        return NULL;
+    pool->free_list = slot->next;
+    slot->next = NULL;
+    pool->in_use++;
+    return slot;
+}
+
+void message_pool_release(message_pool_t *pool, message_slot_t *slot)
+{
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+    pool->in_use--;
+}
+
+void message_pool_destroy(message_pool_t *pool)
+{
+    if (pool->slots == NULL)
+        return;
+    for (size_t s = 0; s < pool->capacity; s++)
+        message_slot_free(&pool->slots[s]);
+    free(pool->slots);
+    pool->slots = NULL;
+    pool->free_list = NULL;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file message_pool.h
+ * @brief Pool of messages with their RELIC objects and signature buffers
+ *
+ * Building a message used to allocate the data points, the message, its
+ * RELIC objects and two buffers per signature, and to free them again.
+ * A pool slot owns all of these. The RELIC objects are created once in
+ * message_pool_init(), and a slot is reset with reset_message() and
+ * encoded with encode_signatures_into() each time it is reused, so the
+ * steady state does not touch the heap.
+ */
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include "message.h"
+
+#define MESSAGE_POOL_DEFAULT_SIZE 4
+
+/**
+ * @brief A message and everything needed to sign and encode it
+ */
+typedef struct message_slot
+{
+    message_t message;
+    dig_t *data_points;
+    unsigned char *sig_bin;     /**< MAX_SIGNATURE_LENGTH bytes per point */
+    char *sig_b64;              /**< MAX_SIGNATURE_B64_LENGTH bytes per point */
+    unsigned char **master;     /**< master[i] points into sig_bin */
+    char **master_decoded;      /**< master_decoded[i] points into sig_b64 */
+    struct message_slot *next;  /**< Next free slot */
+} message_slot_t;
+
+/**
+ * @brief Fixed set of slots and the list of free ones
+ */
+typedef struct message_pool
+{
+    message_slot_t *slots;
+    size_t capacity;
+    size_t num_data_points; /**< Points per message */
+    message_slot_t *free_list;
+    size_t in_use;
+} message_pool_t;
+
+/**
+ * @brief Allocates the slots and creates their RELIC objects
+ *
+ * @param pool Pointer to the pool to initialize
+ * @param capacity Number of messages that can be in use at once
+ * @param num_data_points Number of data points in each message
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int message_pool_init(message_pool_t *pool, size_t capacity, size_t num_data_points);
+
+/**
+ * @brief Takes a free slot
+ *
+ * @param pool Pointer to the pool
+ *
+ * @return Returns the slot, or NULL if all slots are in use
+ */
+message_slot_t *message_pool_acquire(message_pool_t *pool);
+
+/**
+ * @brief Returns a slot to the pool
+ *
+ * @param pool Pointer to the pool
+ * @param slot The slot from message_pool_acquire()
+ */
+void message_pool_release(message_pool_t *pool, message_slot_t *slot);
+
+/**
+ * @brief Frees the slots and their RELIC objects
+ *
+ * @param pool Pointer to the pool
+ */
+void message_pool_destroy(message_pool_t *pool);
+
+#endif
@@ -0,0 +1,45 @@
+#include "batch.h"
+
+int batch_init(batch_t *batch, json_t *json, size_t capacity,
+               char *pk_b64, uint64_t scale, char *func)
+{
+    if (batch == NULL || json == NULL || capacity == 0 || capacity > BATCH_MAX_MESSAGES)
+    {
+        fprintf(stderr, "Invalid batch configuration\n");
+        return -1;
+    }
+    json_reset(json);
+    batch->json = json;
+    batch->count = 0;
+    batch->capacity = capacity;
+    batch->pk_b64 = pk_b64;
+    batch->scale = scale;
+    batch->func = func;
+    return 0;
+}
+
+int batch_add(batch_t *batch, message_t *message, char *master_decoded_sig_buf[],
+              dig_t data_points[], size_t num_data_points, int sig_len)
+{
+    if (batch->count >= batch->capacity)
+    {
+        fprintf(stderr, "Batch is full\n");
+        return -1;
+    }
+    // The shared fields are written with the first message, once the signature length is known
+    if (batch->count == 0 &&
+        prepare_batch_begin(batch->json, batch->pk_b64, sig_len, batch->scale, batch->func) != 0)
+        return -1;
+    if (prepare_batch_add(batch->json, message, master_decoded_sig_buf, data_points,
+                          num_data_points) != 0)
+        return -1;
+    batch->count++;
+    return batch->count == batch->capacity;
+}
+
+int batch_finish(batch_t *batch)
+{
+    if (batch->count == 0)
+        return -1;
+    return prepare_batch_end(batch->json, batch->count);
+}
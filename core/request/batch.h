@@ -0,0 +1,73 @@
+/**
+ * @file batch.h
+ * @brief Accumulates signed messages into one batch request
+ *
+ * A batch collects up to a fixed number of messages into a JSON body with
+ * the shared fields (public key, function, scale, data set) written once,
+ * see prepare_batch_begin(). A finished batch is sent as a single POST to
+ * BATCH_PATH.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "request.h"
+
+#define BATCH_PATH "/new_batch"
+#define BATCH_MAX_MESSAGES 1024
+
+/**
+ * @brief A batch request being filled
+ */
+typedef struct batch
+{
+    json_t *json;     /**< Serializer holding the body, owned by the caller */
+    size_t count;     /**< Messages in the body */
+    size_t capacity;  /**< Messages per request */
+    char *pk_b64;     /**< Base64-encoded public key of every message */
+    uint64_t scale;   /**< Scale factor of every message */
+    char *func;       /**< Function name of every message */
+} batch_t;
+
+/**
+ * @brief Starts an empty batch
+ *
+ * @param batch Pointer to the batch
+ * @param json Serializer the body is written to, reset by the batch
+ * @param capacity Messages per request, between 1 and BATCH_MAX_MESSAGES
+ * @param pk_b64 Base64-encoded public key
+ * @param scale Scale factor
+ * @param func Function name
+ *
+ * @return Returns 0 on success, -1 on invalid arguments
+ */
+int batch_init(batch_t *batch, json_t *json, size_t capacity,
+               char *pk_b64, uint64_t scale, char *func);
+
+/**
+ * @brief Adds a signed message to the batch
+ *
+ * @param batch Pointer to the batch
+ * @param message The signed message
+ * @param master_decoded_sig_buf Array of base64-encoded signatures
+ * @param data_points Array of data points
+ * @param num_data_points Number of data points
+ * @param sig_len Signature length
+ *
+ * @return Returns 1 if the batch is now full, 0 if it has room left, -1 on failure
+ */
+int batch_add(batch_t *batch, message_t *message, char *master_decoded_sig_buf[],
+              dig_t data_points[], size_t num_data_points, int sig_len);
+
+/**
+ * @brief Closes the body of the batch
+ *
+ * The body is then json->buffer with json->pos bytes, ready to be sent on
+ * any connection whose POST header targets BATCH_PATH.
+ *
+ * @param batch Pointer to a batch holding at least one message
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int batch_finish(batch_t *batch);
+
+#endif
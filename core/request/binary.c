@@ -0,0 +1,100 @@
+#include "binary.h"
+
+// Unsigned LEB128, at most BINARY_VARINT_MAX bytes
+static size_t binary_varint(uint8_t *out, uint64_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static int binary_add_varint(json_t *json, uint64_t value)
+{
+    uint8_t buffer[BINARY_VARINT_MAX];
+    return json_write_bytes(json, buffer, binary_varint(buffer, value));
+}
+
+static int binary_add_bytes(json_t *json, const void *data, size_t len)
+{
+    if (binary_add_varint(json, len) != 0)
+        return -1;
+    return json_write_bytes(json, data, len);
+}
+
+int prepare_req_binary(json_t *json, message_t *message, unsigned char *master_sig_buf[],
+                       dig_t data_points[], size_t num_data_points,
+                       const uint8_t *pk, size_t pk_len, int sig_len, uint64_t scale, char *func)
+{
+    if (num_data_points == 0 || sig_len <= 0)
+    {
+        fprintf(stderr, "Nothing to encode\n");
+        return -1;
+    }
+    uint8_t version = BINARY_VERSION;
+    if (json_write_bytes(json, BINARY_MAGIC, sizeof(BINARY_MAGIC) - 1) != 0 ||
+        json_write_bytes(json, &version, 1) != 0)
+    {
+        fprintf(stderr, "Failed to add header\n");
+        return -1;
+    }
+    if (binary_add_bytes(json, message->id, strlen(message->id)) != 0 ||
+        binary_add_bytes(json, message->data_set_id, strlen(message->data_set_id)) != 0 ||
+        binary_add_bytes(json, pk, pk_len) != 0 ||
+        binary_add_bytes(json, func, strlen(func)) != 0)
+    {
+        fprintf(stderr, "Failed to add request fields\n");
+        return -1;
+    }
+    if (binary_add_varint(json, scale) != 0 ||
+        binary_add_varint(json, (uint64_t)sig_len) != 0 ||
+        binary_add_varint(json, num_data_points) != 0)
+    {
+        fprintf(stderr, "Failed to add counts\n");
+        return -1;
+    }
+
+    // Data points as deltas, the small values the client generates take one byte each
+    if (json_check_capacity(json, num_data_points * BINARY_VARINT_MAX) != 0)
+    {
+        fprintf(stderr, "Failed to add datapoints\n");
+        return -1;
+    }
+    uint8_t *out = (uint8_t *)json->buffer + json->pos;
+    size_t len = 0;
+    uint64_t previous = 0;
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        uint64_t delta = (uint64_t)data_points[i] - previous;
+        len += binary_varint(out + len, (delta << 1) ^ (uint64_t)((int64_t)delta >> 63));
+        previous = data_points[i];
+    }
+    json->pos += len;
+
+    if (json_check_capacity(json, num_data_points * (size_t)sig_len) != 0)
+    {
+        fprintf(stderr, "Failed to add signatures\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        memcpy(json->buffer + json->pos, master_sig_buf[i], sig_len);
+        json->pos += sig_len;
+    }
+    json->buffer[json->pos] = '\0';
+
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        const char *tag = message_tag(message, i);
+        if (binary_add_bytes(json, tag, strlen(tag)) != 0)
+        {
+            fprintf(stderr, "Failed to add tag %zu\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
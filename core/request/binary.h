@@ -0,0 +1,49 @@
+/**
+ * @file binary.h
+ * @brief Compact binary request encoding
+ *
+ * An alternative to the JSON body of prepare_req_server(), sent with the
+ * Content-Type BINARY_CONTENT_TYPE. Signatures and the public key travel as
+ * raw compressed points instead of base64, data points as zigzag varint
+ * deltas instead of decimal and tags with a length prefix instead of quotes.
+ * All integers are unsigned LEB128 varints, strings are a varint length
+ * followed by the bytes:
+ *
+ *   "OCPB" version
+ *   id data_set_id public_key function      strings
+ *   scale signature_length count            varints
+ *   count varints                           data point i minus data point i-1, zigzag
+ *   count * signature_length bytes          signatures
+ *   count strings                           tags
+ */
+#ifndef BINARY_H
+#define BINARY_H
+
+#include "json.h"
+#include "../message/message.h"
+
+#define BINARY_MAGIC "OCPB"
+#define BINARY_VERSION 1
+#define BINARY_CONTENT_TYPE "application/vnd.ocp.mklhs"
+#define BINARY_VARINT_MAX 10
+
+/**
+ * @brief Prepare a request in the binary encoding
+ *
+ * @param json Buffer to fill, the same growable buffer JSON requests use
+ * @param message Message structure containing IDs and tags
+ * @param master_sig_buf Array of binary signatures
+ * @param data_points Array of data points
+ * @param num_data_points Number of data points
+ * @param pk Compressed public key
+ * @param pk_len Length of the public key
+ * @param sig_len Signature length
+ * @param scale Scale factor
+ * @param func Function name
+ * @return 0 on success, -1 on error
+ */
+int prepare_req_binary(json_t *json, message_t *message, unsigned char *master_sig_buf[],
+                       dig_t data_points[], size_t num_data_points,
+                       const uint8_t *pk, size_t pk_len, int sig_len, uint64_t scale, char *func);
+
+#endif /* BINARY_H */
@@ -0,0 +1,108 @@
+#include <time.h>
+
+#include "compare.h"
+#include "request.h"
+#include "binary.h"
+#include "../message/message_pool.h"
+#include "../crypto/mklhs/key_manager.h"
+#include "../utils/utils.h"
+
+static double compare_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void compare_row(FILE *out, const char *format, size_t bytes, size_t num_data_points,
+                        double seconds, size_t iterations)
+{
+    fprintf(out, "%-8s %10zu %12.2f %12.2f\n", format, bytes, (double)bytes / num_data_points,
+            seconds * 1e6 / iterations);
+}
+
+int request_compare(FILE *out, size_t num_data_points, size_t iterations)
+{
+    if (iterations == 0)
+        return -1;
+    int result = -1;
+    bn_t sk;
+    g2_t pk;
+    bn_null(sk);
+    g2_null(pk);
+    bn_new(sk);
+    g2_new(pk);
+    mklhs_key_t *key = NULL;
+    message_pool_t pool;
+    json_t json;
+    request_template_t tpl;
+    if (cp_mklhs_gen(sk, pk) != RLC_OK || (key = key_new(sk, pk, NULL)) == NULL)
+    {
+        fprintf(stderr, "Failed to generate keys\n");
+        goto cleanup_keys;
+    }
+    if (message_pool_init(&pool, 1, num_data_points) != 0)
+        goto cleanup_keys;
+    if (json_init_growable(&json, NULL, 0) != 0)
+        goto cleanup_pool;
+    if (request_template_init(&tpl) != 0)
+        goto cleanup_json;
+
+    message_slot_t *slot = message_pool_acquire(&pool);
+    message_t *message = &slot->message;
+    if (gen_dig_data_points(slot->data_points, num_data_points) != 0 ||
+        reset_message(message, slot->data_points, num_data_points) != 0 ||
+        signer_sign_points(&key->signer, message, 0, num_data_points) != 0)
+        goto cleanup;
+
+    // Each format starts from the signed points like the client does, JSON encodes
+    // the points to base64 in place around the constant fields compiled once per key
+    if (normalize_signatures(message, num_data_points) != 0 ||
+        request_template_compile(&tpl, key->serial, message->id, TEST_DATABASE, key->pk_b64,
+                                 g1_size_bin(message->sigs[0], 1), 1, FUNC) != 0)
+        goto cleanup;
+    double start = compare_now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        json_reset(&json);
+        if (normalize_signatures(message, num_data_points) != 0 ||
+            prepare_req_template(&json, &tpl, message, NULL, slot->data_points,
+                                 num_data_points) != 0)
+            goto cleanup;
+    }
+    double json_s = compare_now() - start;
+    size_t json_bytes = json.pos;
+
+    start = compare_now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        json_reset(&json);
+        int sig_len = write_signatures(message, slot->master, num_data_points);
+        if (sig_len < 0 ||
+            prepare_req_binary(&json, message, slot->master, slot->data_points, num_data_points,
+                               key->pk_bin, key->pk_len, sig_len, 1, FUNC) != 0)
+            goto cleanup;
+    }
+    double binary_s = compare_now() - start;
+    size_t binary_bytes = json.pos;
+
+    fprintf(out, "%-8s %10s %12s %12s\n", "format", "bytes", "bytes/point", "us/request");
+    compare_row(out, "json", json_bytes, num_data_points, json_s, iterations);
+    compare_row(out, "binary", binary_bytes, num_data_points, binary_s, iterations);
+    fprintf(out, "Binary requests are %.1f%% of the JSON size for %zu data points\n",
+            100.0 * binary_bytes / json_bytes, num_data_points);
+    result = 0;
+
+cleanup:
+    message_pool_release(&pool, slot);
+    request_template_free(&tpl);
+cleanup_json:
+    json_free(&json);
+cleanup_pool:
+    message_pool_destroy(&pool);
+cleanup_keys:
+    key_free(key);
+    bn_free(sk);
+    g2_free(pk);
+    return result;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file compare.h
+ * @brief Size and encoding cost of JSON and binary requests
+ *
+ * Signs one message and encodes it in both request formats, from the signed
+ * points to the finished body, so the rows show the bytes each format puts on
+ * the wire per data point and the CPU time it takes per request.
+ */
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdio.h>
+
+#define COMPARE_DEFAULT_ITERATIONS 1000
+
+/**
+ * @brief Encodes one signed message in both formats and prints one row per format
+ *
+ * @param out Stream to print the table to
+ * @param num_data_points Number of data points in the message
+ * @param iterations Times each format is encoded
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int request_compare(FILE *out, size_t num_data_points, size_t iterations);
+
+#endif
@@ -1,4 +1,8 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "json.h"
+#include "../utils/base64.h"
 
 void json_init(json_t *json, char *buffer, size_t capacity)
 {
@@ -7,13 +11,64 @@ void json_init(json_t *json, char *buffer, size_t capacity)
     json->capacity = capacity;
     json->pos = 0;
     json->error = 0;
+    json->growable = 0;
+    json->owned = 0;
+}
+
+int json_init_growable(json_t *json, char *buffer, size_t capacity)
+{
+    int owned = 0;
+    if (buffer == NULL)
+    {
+        capacity = 0;
+        if (buffer_reserve(&buffer, &capacity, JSON_BUFFER_SIZE) != 0)
+            return -1;
+        owned = 1;
+    }
+    json_init(json, buffer, capacity);
+    json->growable = 1;
+    json->owned = owned;
+    return 0;
+}
+
+void json_reset(json_t *json)
+{
+    json->buffer[0] = '\0';
+    json->pos = 0;
+    json->error = 0;
+}
+
+void json_free(json_t *json)
+{
+    if (json->owned)
+        free(json->buffer);
+    json->buffer = NULL;
+    json->capacity = 0;
+    json->owned = 0;
 }
 
 int json_check_capacity(json_t *json, size_t needed)
 {
-    if (json->pos + needed >= json->capacity)
+    if (json->pos + needed < json->capacity)
+        return 0;
+    if (!json->growable)
         return json->error = -1;
 
+    // Move off the caller's buffer before growing it
+    if (!json->owned)
+    {
+        char *heap = NULL;
+        size_t capacity = 0;
+        if (buffer_reserve(&heap, &capacity, json->pos + needed + 1) != 0)
+            return json->error = -1;
+        memcpy(heap, json->buffer, json->pos + 1);
+        json->buffer = heap;
+        json->capacity = capacity;
+        json->owned = 1;
+        return 0;
+    }
+    if (buffer_reserve(&json->buffer, &json->capacity, json->pos + needed + 1) != 0)
+        return json->error = -1;
     return 0;
 }
 
@@ -33,6 +88,16 @@ int json_write(json_t *json, const char *str)
     return 0;
 }
 
+int json_write_bytes(json_t *json, const void *data, size_t len)
+{
+    if (json_check_capacity(json, len) != 0)
+        return json->error = -1;
+    memcpy(json->buffer + json->pos, data, len);
+    json->pos += len;
+    json->buffer[json->pos] = '\0';
+    return 0;
+}
+
 int json_add_comma(json_t *json)
 {
     return json_write(json, ",");
@@ -88,6 +153,34 @@ int json_add_string(json_t *json, const char *str)
     return json_write(json, "\"");
 }
 
+int json_add_g1(json_t *json, const g1_t point, int len)
+{
+    uint8_t bin[RLC_FP_BYTES + 1];
+    if (len <= 0 || len > (int)sizeof(bin))
+        return json->error = -1;
+    size_t encoded_len = base64_out_len(len);
+    if (json_check_capacity(json, encoded_len + 2) != 0)
+        return json->error = -1;
+    int result = 0;
+    RLC_TRY
+    {
+        g1_write_bin(bin, len, point, 1);
+    }
+    RLC_CATCH_ANY
+    {
+        result = -1;
+    }
+    if (result != 0)
+        return json->error = -1;
+    char *out = json->buffer + json->pos;
+    out[0] = '"';
+    base64_enc_buf((const char *)bin, len, out + 1);
+    out[encoded_len + 1] = '"';
+    json->pos += encoded_len + 2;
+    json->buffer[json->pos] = '\0';
+    return 0;
+}
+
 // Modified to separate adding the number from adding the comma
 int json_add_number(json_t *json, unsigned long long number)
 {
@@ -10,13 +10,18 @@
 #define JSON_H
 
 #define JSON_BUFFER_SIZE 4096
+#define JSON_CONTENT_TYPE "application/json"
 #include <stddef.h>
 #include "relic/relic.h"
 #include "../utils/bad_string.h"
+#include "../utils/buffer.h"
 
 /**
  * @struct json_t
  * @brief Structure for JSON serialization using a pre-allocated buffer.
+ *
+ * A growable serializer starts in the given buffer and moves to a heap buffer
+ * that doubles in size once the output does not fit anymore.
  */
 typedef struct json
 {
@@ -24,6 +29,8 @@ typedef struct json
     size_t capacity; /**< Total capacity of the buffer */
     size_t pos;      /**< Current position in the buffer */
     int error;       /**< Error flag (0 for success, -1 for error) */
+    int growable;    /**< Grow the buffer instead of failing when it is full */
+    int owned;       /**< The buffer is on the heap and freed by json_free() */
 } json_t;
 
 /**
@@ -35,12 +42,37 @@ typedef struct json
  */
 void json_init(json_t *json, char *buffer, size_t capacity);
 
+/**
+ * @brief Initialize a JSON serializer that grows as needed.
+ *
+ * @param json Pointer to a json_t structure to initialize
+ * @param buffer Buffer to start in, may be NULL to start on the heap
+ * @param capacity Size of the buffer, ignored if buffer is NULL
+ * @return 0 on success, -1 if the initial buffer could not be allocated
+ */
+int json_init_growable(json_t *json, char *buffer, size_t capacity);
+
+/**
+ * @brief Clear the serializer for a new document, keeping its buffer.
+ *
+ * @param json Pointer to a json_t structure
+ */
+void json_reset(json_t *json);
+
+/**
+ * @brief Free the heap buffer of a growable serializer.
+ *
+ * @param json Pointer to a json_t structure
+ */
+void json_free(json_t *json);
+
 /**
  * @brief Check if there's enough capacity in the buffer.
  *
  * @param json Pointer to a json_t structure
  * @param needed Number of bytes needed for the next operation
- * @return 0 on success, -1 if buffer capacity would be exceeded
+ * @return 0 on success, -1 if buffer capacity would be exceeded and the
+ *         buffer cannot grow
  */
 int json_check_capacity(json_t *json, size_t needed);
 
@@ -53,6 +85,18 @@ int json_check_capacity(json_t *json, size_t needed);
  */
 int json_write(json_t *json, const char *str);
 
+/**
+ * @brief Write raw bytes to the buffer.
+ *
+ * Lets the binary request encoding (binary.h) use the same growable buffers.
+ *
+ * @param json Pointer to a json_t structure
+ * @param data Bytes to write, may contain NUL
+ * @param len Number of bytes
+ * @return 0 on success, -1 on error
+ */
+int json_write_bytes(json_t *json, const void *data, size_t len);
+
 /**
  * @brief Add a comma to the JSON buffer.
  *
@@ -111,6 +155,20 @@ int json_add_key(json_t *json, const char *key);
  */
 int json_add_string(json_t *json, const char *str);
 
+/**
+ * @brief Add a G1 point as a quoted base64 string of its compressed form.
+ *
+ * The point is serialized on the stack and encoded straight into the buffer,
+ * so nothing is allocated or copied twice. Normalize the point first, else
+ * the serialization inverts its z coordinate.
+ *
+ * @param json Pointer to a json_t structure
+ * @param point The point to add
+ * @param len Length of the compressed point, g1_size_bin(point, 1)
+ * @return 0 on success, -1 on error
+ */
+int json_add_g1(json_t *json, const g1_t point, int len);
+
 /**
  * @brief Add a number value to the JSON buffer.
  *
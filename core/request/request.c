@@ -1,5 +1,14 @@
 #include "request.h"
 
+// The base64 string of signature i, or the point encoded in place if there are no strings
+static int request_add_signature(json_t *json, message_t *message, char *master_decoded_sig_buf[],
+                                 size_t i, int sig_len)
+{
+    if (master_decoded_sig_buf == NULL)
+        return json_add_g1(json, message->sigs[i], sig_len);
+    return json_add_string(json, master_decoded_sig_buf[i]);
+}
+
 int prepare_req_server(json_t *json, message_t *message, char *master_decoded_sig_buf[],
                        dig_t data_points[], size_t num_data_points,
                        char *pk_b64, int sig_len, uint64_t scale, char *func)
@@ -17,7 +26,7 @@ int prepare_req_server(json_t *json, message_t *message, char *master_decoded_si
         fprintf(stderr, "Failed to add id key\n");
         return -1;
     }
-    if (json_add_string(json, message->ids[0]) != 0)
+    if (json_add_string(json, message->id) != 0)
     {
         fprintf(stderr, "Failed to add id value\n");
         return -1;
@@ -79,7 +88,7 @@ int prepare_req_server(json_t *json, message_t *message, char *master_decoded_si
     }
     for (size_t i = 0; i < num_data_points; i++)
     {
-        if (json_add_string(json, master_decoded_sig_buf[i]) != 0)
+        if (request_add_signature(json, message, master_decoded_sig_buf, i, sig_len) != 0)
         {
             fprintf(stderr, "Failed to add signature %zu\n", i);
             return -1;
@@ -134,7 +143,7 @@ int prepare_req_server(json_t *json, message_t *message, char *master_decoded_si
     }
     for (size_t i = 0; i < num_data_points; i++)
     {
-        if (json_add_string(json, message->tags[i]) != 0)
+        if (json_add_string(json, message_tag(message, i)) != 0)
         {
             fprintf(stderr, "Failed to add tag %zu\n", i);
             return -1;
@@ -235,3 +244,274 @@ int prepare_req_server(json_t *json, message_t *message, char *master_decoded_si
 
     return 0;
 }
+
+int request_template_init(request_template_t *tpl)
+{
+    memset(tpl, 0, sizeof(request_template_t));
+    return json_init_growable(&tpl->json, NULL, 0);
+}
+
+int request_template_compile(request_template_t *tpl, size_t key_serial, const char *id,
+                             const char *data_set_id, const char *pk_b64, int sig_len,
+                             uint64_t scale, const char *func)
+{
+    json_t *json = &tpl->json;
+    tpl->compiled = 0;
+    json_reset(json);
+
+    // {"id":..,"datapoints":[
+    if (json_start_object(json) != 0 || json_add_key_value_string(json, "id", id) != 0 ||
+        json_add_key(json, "datapoints") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to compile request prefix\n");
+        return -1;
+    }
+    tpl->ends[0] = json->pos;
+
+    // ],"signatures":[
+    if (json_write(json, "],") != 0 || json_add_key(json, "signatures") != 0 ||
+        json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to compile signatures key\n");
+        return -1;
+    }
+    tpl->ends[1] = json->pos;
+
+    // ],"signature_length":..,"tags":[
+    if (json_write(json, "],") != 0 ||
+        json_add_key_value_number(json, "signature_length", sig_len) != 0 ||
+        json_add_key(json, "tags") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to compile tags key\n");
+        return -1;
+    }
+    tpl->ends[2] = json->pos;
+
+    // ],"data_set_id":..,"public_key":..,"scale":..,"function":..}
+    if (json_write(json, "],") != 0 ||
+        json_add_key_value_string(json, "data_set_id", data_set_id) != 0 ||
+        json_add_key_value_string(json, "public_key", pk_b64) != 0 ||
+        json_add_key_value_number(json, "scale", scale) != 0 ||
+        json_add_key_value_string(json, "function", func) != 0 || json_end_object(json) != 0)
+    {
+        fprintf(stderr, "Failed to compile request suffix\n");
+        return -1;
+    }
+    tpl->ends[3] = json->pos;
+
+    tpl->key_serial = key_serial;
+    tpl->sig_len = sig_len;
+    tpl->scale = scale;
+    tpl->compiled = 1;
+    return 0;
+}
+
+int request_template_matches(const request_template_t *tpl, size_t key_serial, int sig_len,
+                             uint64_t scale)
+{
+    return tpl->compiled && tpl->key_serial == key_serial && tpl->sig_len == sig_len &&
+           tpl->scale == scale;
+}
+
+void request_template_free(request_template_t *tpl)
+{
+    json_free(&tpl->json);
+    tpl->compiled = 0;
+}
+
+// Copy segment i of a compiled template
+static int request_template_write(json_t *json, const request_template_t *tpl, int i)
+{
+    size_t start = i == 0 ? 0 : tpl->ends[i - 1];
+    return json_write_bytes(json, tpl->json.buffer + start, tpl->ends[i] - start);
+}
+
+int prepare_req_template(json_t *json, const request_template_t *tpl, message_t *message,
+                         char *master_decoded_sig_buf[], dig_t data_points[],
+                         size_t num_data_points)
+{
+    if (!tpl->compiled)
+    {
+        fprintf(stderr, "Request template is not compiled\n");
+        return -1;
+    }
+
+    if (request_template_write(json, tpl, 0) != 0)
+    {
+        fprintf(stderr, "Failed to add request prefix\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (json_add_number(json, data_points[i]) != 0 ||
+            (i < num_data_points - 1 && json_add_comma(json) != 0))
+        {
+            fprintf(stderr, "Failed to add datapoint %zu\n", i);
+            return -1;
+        }
+    }
+
+    if (request_template_write(json, tpl, 1) != 0)
+    {
+        fprintf(stderr, "Failed to add signatures key\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (request_add_signature(json, message, master_decoded_sig_buf, i, tpl->sig_len) != 0 ||
+            (i < num_data_points - 1 && json_add_comma(json) != 0))
+        {
+            fprintf(stderr, "Failed to add signature %zu\n", i);
+            return -1;
+        }
+    }
+
+    if (request_template_write(json, tpl, 2) != 0)
+    {
+        fprintf(stderr, "Failed to add tags key\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (json_add_string(json, message_tag(message, i)) != 0 ||
+            (i < num_data_points - 1 && json_add_comma(json) != 0))
+        {
+            fprintf(stderr, "Failed to add tag %zu\n", i);
+            return -1;
+        }
+    }
+
+    if (request_template_write(json, tpl, 3) != 0)
+    {
+        fprintf(stderr, "Failed to add request suffix\n");
+        return -1;
+    }
+    return 0;
+}
+
+int prepare_batch_begin(json_t *json, char *pk_b64, int sig_len, uint64_t scale, char *func)
+{
+    if (json_start_object(json) != 0)
+    {
+        fprintf(stderr, "Failed to start JSON object\n");
+        return -1;
+    }
+    // Fields shared by every message, written once per batch
+    if (json_add_key_value_string(json, "data_set_id", TEST_DATABASE) != 0 ||
+        json_add_key_value_string(json, "public_key", pk_b64) != 0 ||
+        json_add_key_value_number(json, "signature_length", sig_len) != 0 ||
+        json_add_key_value_number(json, "scale", scale) != 0 ||
+        json_add_key_value_string(json, "function", func) != 0)
+    {
+        fprintf(stderr, "Failed to add batch fields\n");
+        return -1;
+    }
+    if (json_add_key(json, "messages") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to start messages array\n");
+        return -1;
+    }
+    return 0;
+}
+
+int prepare_batch_add(json_t *json, message_t *message, char *master_decoded_sig_buf[],
+                      dig_t data_points[], size_t num_data_points)
+{
+    if (json_start_object(json) != 0)
+    {
+        fprintf(stderr, "Failed to start message object\n");
+        return -1;
+    }
+    if (json_add_key_value_string(json, "id", message->id) != 0)
+    {
+        fprintf(stderr, "Failed to add id\n");
+        return -1;
+    }
+
+    if (json_add_key(json, "datapoints") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to start datapoints array\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (json_add_number(json, data_points[i]) != 0 || json_add_comma(json) != 0)
+        {
+            fprintf(stderr, "Failed to add datapoint %zu\n", i);
+            return -1;
+        }
+    }
+    if (json_end_array(json) != 0 || json_add_comma(json) != 0)
+    {
+        fprintf(stderr, "Failed to end datapoints array\n");
+        return -1;
+    }
+
+    if (json_add_key(json, "signatures") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to start signatures array\n");
+        return -1;
+    }
+    int sig_len = g1_size_bin(message->sigs[0], 1);
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (request_add_signature(json, message, master_decoded_sig_buf, i, sig_len) != 0 ||
+            json_add_comma(json) != 0)
+        {
+            fprintf(stderr, "Failed to add signature %zu\n", i);
+            return -1;
+        }
+    }
+    if (json_end_array(json) != 0 || json_add_comma(json) != 0)
+    {
+        fprintf(stderr, "Failed to end signatures array\n");
+        return -1;
+    }
+
+    if (json_add_key(json, "tags") != 0 || json_start_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to start tags array\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+    {
+        if (json_add_string(json, message_tag(message, i)) != 0 || json_add_comma(json) != 0)
+        {
+            fprintf(stderr, "Failed to add tag %zu\n", i);
+            return -1;
+        }
+    }
+    if (json_end_array(json) != 0)
+    {
+        fprintf(stderr, "Failed to end tags array\n");
+        return -1;
+    }
+
+    // The trailing comma is dropped by the next message or prepare_batch_end()
+    if (json_end_object(json) != 0 || json_add_comma(json) != 0)
+    {
+        fprintf(stderr, "Failed to end message object\n");
+        return -1;
+    }
+    return 0;
+}
+
+int prepare_batch_end(json_t *json, size_t count)
+{
+    if (json_end_array(json) != 0 || json_add_comma(json) != 0)
+    {
+        fprintf(stderr, "Failed to end messages array\n");
+        return -1;
+    }
+    if (json_add_key(json, "count") != 0 || json_add_number(json, count) != 0)
+    {
+        fprintf(stderr, "Failed to add count\n");
+        return -1;
+    }
+    if (json_end_object(json) != 0)
+    {
+        fprintf(stderr, "Failed to end JSON object\n");
+        return -1;
+    }
+    return 0;
+}
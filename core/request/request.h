@@ -16,7 +16,8 @@
  *
  * @param json Custom JSON structure to fill
  * @param message Message structure containing IDs and tags
- * @param master_decoded_sig_buf Array of base64-encoded signatures
+ * @param master_decoded_sig_buf Array of base64-encoded signatures, NULL to encode the
+ *        normalized signatures of the message straight into the buffer
  * @param data_points Array of data points
  * @param num_data_points Number of data points
  * @param pk_b64 Base64-encoded public key
@@ -29,4 +30,132 @@ int prepare_req_server(json_t *json, message_t *message, char *master_decoded_si
                        dig_t data_points[], size_t num_data_points,
                        char *pk_b64, int sig_len, uint64_t scale, char *func);
 
+/**
+ * @brief The constant parts of a request, rendered once
+ *
+ * A request is four constant segments with the data points, signatures and
+ * tags arrays in between:
+ * {"id":..,"datapoints":[ | ],"signatures":[ | ],"signature_length":..,"tags":[ |
+ * ],"data_set_id":..,"public_key":..,"scale":..,"function":..}
+ * The segments only change with the key, the signature length or the scale,
+ * so they are compiled once and copied into every request with one memcpy each.
+ */
+typedef struct request_template
+{
+    json_t json;       /**< The segments back to back */
+    size_t ends[4];    /**< Segment i ends at ends[i] */
+    int compiled;      /**< The segments below are valid */
+    size_t key_serial; /**< Key the public key belongs to */
+    int sig_len;       /**< Signature length */
+    uint64_t scale;    /**< Scale factor */
+} request_template_t;
+
+/**
+ * @brief Initialize an empty request template
+ *
+ * @param tpl Pointer to the template
+ * @return 0 on success, -1 on error
+ */
+int request_template_init(request_template_t *tpl);
+
+/**
+ * @brief Render the constant segments of a request
+ *
+ * Reuses the buffer of the previous segments, so recompiling after a key
+ * rotation does not allocate.
+ *
+ * @param tpl Pointer to a template set up with request_template_init()
+ * @param key_serial Serial of the key pk_b64 belongs to
+ * @param id Device id
+ * @param data_set_id Dataset identifier
+ * @param pk_b64 Base64-encoded public key
+ * @param sig_len Signature length
+ * @param scale Scale factor
+ * @param func Function name
+ * @return 0 on success, -1 on error
+ */
+int request_template_compile(request_template_t *tpl, size_t key_serial, const char *id,
+                             const char *data_set_id, const char *pk_b64, int sig_len,
+                             uint64_t scale, const char *func);
+
+/**
+ * @brief Check whether a template was compiled for a key, signature length and scale
+ *
+ * @param tpl Pointer to the template
+ * @param key_serial Serial of the key
+ * @param sig_len Signature length
+ * @param scale Scale factor
+ * @return 1 if the template can be used as is, 0 if it has to be compiled
+ */
+int request_template_matches(const request_template_t *tpl, size_t key_serial, int sig_len,
+                             uint64_t scale);
+
+/**
+ * @brief Free the buffer of a request template
+ *
+ * @param tpl Pointer to the template
+ */
+void request_template_free(request_template_t *tpl);
+
+/**
+ * @brief Prepare a request from a compiled template
+ *
+ * Writes the same bytes as prepare_req_server() with the fields the template
+ * was compiled with, but only the arrays are serialized.
+ *
+ * @param json Custom JSON structure to fill
+ * @param tpl Template compiled for the key of the message
+ * @param message Message structure containing the tags, its id must be the template's
+ * @param master_decoded_sig_buf Array of base64-encoded signatures, NULL to encode the
+ *        normalized signatures of the message straight into the buffer
+ * @param data_points Array of data points
+ * @param num_data_points Number of data points
+ * @return 0 on success, -1 on error
+ */
+int prepare_req_template(json_t *json, const request_template_t *tpl, message_t *message,
+                         char *master_decoded_sig_buf[], dig_t data_points[],
+                         size_t num_data_points);
+
+/**
+ * @brief Start a batch request holding several messages
+ *
+ * The fields every message of the batch shares are written once:
+ * {"data_set_id":..,"public_key":..,"signature_length":..,"scale":..,
+ * "function":..,"messages":[ followed by one object per message
+ * (see prepare_batch_add()) and closed by prepare_batch_end().
+ *
+ * @param json Custom JSON structure to fill
+ * @param pk_b64 Base64-encoded public key
+ * @param sig_len Signature length
+ * @param scale Scale factor
+ * @param func Function name
+ * @return 0 on success, -1 on error
+ */
+int prepare_batch_begin(json_t *json, char *pk_b64, int sig_len, uint64_t scale, char *func);
+
+/**
+ * @brief Add one message to a batch request
+ *
+ * Writes {"id":..,"datapoints":[..],"signatures":[..],"tags":[..]}.
+ *
+ * @param json Custom JSON structure started with prepare_batch_begin()
+ * @param message Message structure containing IDs and tags
+ * @param master_decoded_sig_buf Array of base64-encoded signatures, NULL to encode the
+ *        normalized signatures of the message straight into the buffer
+ * @param data_points Array of data points
+ * @param num_data_points Number of data points
+ * @return 0 on success, -1 on error
+ */
+int prepare_batch_add(json_t *json, message_t *message, char *master_decoded_sig_buf[],
+                      dig_t data_points[], size_t num_data_points);
+
+/**
+ * @brief Close a batch request
+ *
+ * @param json Custom JSON structure holding the batch
+ * @param count Number of messages added to the batch
+ * @return 0 on success, -1 on error
+ */
+int prepare_batch_end(json_t *json, size_t count);
+
 #endif /* REQUEST_H */
\ No newline at end of file
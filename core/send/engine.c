@@ -0,0 +1,509 @@
+#include "engine.h"
+
+#include <time.h>
+
+uint64_t engine_now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Arm the timer for the given deadline if it is earlier than the current one
+static void engine_arm_timer(engine_t *engine, uint64_t deadline_ms)
+{
+    if (deadline_ms == 0 || (engine->next_deadline != 0 && engine->next_deadline <= deadline_ms))
+        return;
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline_ms / 1000;
+    spec.it_value.tv_nsec = (deadline_ms % 1000) * 1000000L;
+    if (timerfd_settime(engine->timerfd, TFD_TIMER_ABSTIME, &spec, NULL) == 0)
+        engine->next_deadline = deadline_ms;
+}
+
+static int engine_watch(engine_conn_t *conn, uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    return epoll_ctl(conn->engine->epfd, EPOLL_CTL_MOD, conn->socket, &ev);
+}
+
+static void engine_complete(engine_conn_t *conn, engine_request_t *req, int result)
+{
+    if (conn->current == req)
+        conn->current = NULL;
+    req->result = result;
+    req->done = 1;
+    req->conn = NULL;
+    conn->engine->inflight--;
+    if (req->callback != NULL)
+        req->callback(req, req->arg);
+}
+
+// Fail the current and every queued request, the connection cannot be used anymore
+static void engine_conn_fail(engine_conn_t *conn, int result)
+{
+    if (conn->state == ENGINE_CONN_FREE || conn->state == ENGINE_CONN_DEAD)
+        return;
+    epoll_ctl(conn->engine->epfd, EPOLL_CTL_DEL, conn->socket, NULL);
+    conn->state = ENGINE_CONN_DEAD;
+
+    engine_request_t *failed = conn->head;
+    conn->head = conn->tail = NULL;
+    if (conn->current != NULL)
+        engine_complete(conn, conn->current, result);
+    while (failed != NULL)
+    {
+        engine_request_t *next = failed->next;
+        engine_complete(conn, failed, ENGINE_ERROR);
+        failed = next;
+    }
+}
+
+static void engine_conn_write(engine_conn_t *conn);
+
+// Start the next queued request if the connection is free
+static void engine_conn_start(engine_conn_t *conn)
+{
+    if (conn->state != ENGINE_CONN_IDLE || conn->head == NULL)
+        return;
+    conn->current = conn->head;
+    conn->head = conn->head->next;
+    if (conn->head == NULL)
+        conn->tail = NULL;
+    conn->state = ENGINE_CONN_WRITING;
+    // Most requests fit in the socket buffer, try right away
+    engine_conn_write(conn);
+}
+
+static void engine_conn_write(engine_conn_t *conn)
+{
+    engine_request_t *req = conn->current;
+    while (req->iovcnt > 0)
+    {
+        struct iovec *cur = req->iov + (3 - req->iovcnt);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = cur;
+        msg.msg_iovlen = req->iovcnt;
+        ssize_t sent = sendmsg(conn->socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                engine_watch(conn, EPOLLOUT);
+                return;
+            }
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return;
+        }
+        while (req->iovcnt > 0 && (size_t)sent >= cur->iov_len)
+        {
+            sent -= cur->iov_len;
+            cur++;
+            req->iovcnt--;
+        }
+        if (req->iovcnt > 0)
+        {
+            cur->iov_base = (char *)cur->iov_base + sent;
+            cur->iov_len -= sent;
+        }
+    }
+    conn->state = ENGINE_CONN_READING;
+    engine_watch(conn, EPOLLIN);
+}
+
+static int engine_conn_read(engine_conn_t *conn)
+{
+    engine_request_t *req = conn->current;
+    for (;;)
+    {
+        if (req->response_len >= req->response_size - 1)
+        {
+            // Response does not fit, the rest of it would desync the connection
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return 1;
+        }
+        ssize_t received = recv(conn->socket, req->response + req->response_len,
+                                req->response_size - 1 - req->response_len, 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return 1;
+        }
+        if (received == 0)
+        {
+            // Bodies without a length end when the server closes the connection
+            if (http_parser_eof(&req->parser, req->response) == HTTP_PARSE_DONE)
+            {
+                req->status = req->parser.status;
+                engine_complete(conn, req, ENGINE_OK);
+            }
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return 1;
+        }
+        req->response_len += received;
+        int parsed = http_parser_feed(&req->parser, req->response, req->response_len);
+        if (parsed == HTTP_PARSE_ERROR)
+        {
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return 1;
+        }
+        if (parsed == HTTP_PARSE_MORE)
+        {
+            req->response[req->response_len] = '\0';
+            continue;
+        }
+
+        req->response_len = req->parser.offset;
+        req->response[req->response_len] = '\0';
+        req->status = req->parser.status;
+        int keep_alive = req->parser.keep_alive;
+        conn->state = ENGINE_CONN_IDLE;
+        engine_complete(conn, req, ENGINE_OK);
+        if (!keep_alive)
+        {
+            engine_conn_fail(conn, ENGINE_ERROR);
+            return 1;
+        }
+        // The callback may already have started the next request
+        if (conn->state == ENGINE_CONN_IDLE)
+        {
+            // Idle connections still watch for the server closing them
+            engine_watch(conn, EPOLLIN);
+            engine_conn_start(conn);
+        }
+        return 1;
+    }
+}
+
+// Fail every request whose deadline has passed and re-arm the timer
+static int engine_expire(engine_t *engine)
+{
+    uint64_t now = engine_now_ms();
+    int expired = 0;
+    engine->next_deadline = 0;
+    for (size_t i = 0; i < engine->max_conns; i++)
+    {
+        engine_conn_t *conn = &engine->conns[i];
+        if (conn->current != NULL && conn->current->deadline_ms != 0 &&
+            conn->current->deadline_ms <= now)
+        {
+            // A late response would be taken for the next request, drop the connection
+            expired++;
+            engine_conn_fail(conn, ENGINE_TIMEOUT);
+            continue;
+        }
+        // Queued requests can expire before they are sent
+        engine_request_t **link = &conn->head;
+        while (*link != NULL)
+        {
+            engine_request_t *req = *link;
+            if (req->deadline_ms != 0 && req->deadline_ms <= now)
+            {
+                *link = req->next;
+                if (conn->tail == req)
+                    conn->tail = NULL;
+                expired++;
+                engine_complete(conn, req, ENGINE_TIMEOUT);
+                continue;
+            }
+            link = &req->next;
+        }
+        if (conn->tail == NULL)
+        {
+            for (engine_request_t *req = conn->head; req != NULL; req = req->next)
+                conn->tail = req;
+        }
+    }
+    // Re-arm for the earliest remaining deadline
+    struct itimerspec disarm;
+    memset(&disarm, 0, sizeof(disarm));
+    timerfd_settime(engine->timerfd, 0, &disarm, NULL);
+    for (size_t i = 0; i < engine->max_conns; i++)
+    {
+        engine_conn_t *conn = &engine->conns[i];
+        if (conn->current != NULL)
+            engine_arm_timer(engine, conn->current->deadline_ms);
+        for (engine_request_t *req = conn->head; req != NULL; req = req->next)
+            engine_arm_timer(engine, req->deadline_ms);
+    }
+    return expired;
+}
+
+int engine_init(engine_t *engine, size_t max_conns)
+{
+    if (engine == NULL || max_conns == 0 || max_conns > ENGINE_MAX_CONNECTIONS)
+        return -1;
+    memset(engine, 0, sizeof(engine_t));
+    engine->epfd = engine->timerfd = -1;
+    engine->conns = (engine_conn_t *)calloc(max_conns, sizeof(engine_conn_t));
+    if (engine->conns == NULL)
+        return -1;
+    engine->max_conns = max_conns;
+
+    engine->epfd = epoll_create1(EPOLL_CLOEXEC);
+    engine->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (engine->epfd < 0 || engine->timerfd < 0)
+    {
+        perror("Could not create event loop");
+        engine_destroy(engine);
+        return -1;
+    }
+    // The timer is told apart from connections by its data pointer
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = engine;
+    if (epoll_ctl(engine->epfd, EPOLL_CTL_ADD, engine->timerfd, &ev) < 0)
+    {
+        engine_destroy(engine);
+        return -1;
+    }
+    return 0;
+}
+
+static engine_conn_t *engine_add(engine_t *engine, int sock, int owned,
+                                 engine_conn_state_t state, uint32_t events)
+{
+    engine_conn_t *conn = NULL;
+    for (size_t i = 0; i < engine->max_conns; i++)
+    {
+        if (engine->conns[i].state == ENGINE_CONN_FREE)
+        {
+            conn = &engine->conns[i];
+            break;
+        }
+    }
+    if (conn == NULL)
+    {
+        fprintf(stderr, "Engine connection limit reached\n");
+        return NULL;
+    }
+    memset(conn, 0, sizeof(engine_conn_t));
+    conn->socket = sock;
+    conn->owned = owned;
+    conn->engine = engine;
+    conn->state = state;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(engine->epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+        conn->state = ENGINE_CONN_FREE;
+        return NULL;
+    }
+    return conn;
+}
+
+engine_conn_t *engine_connect(engine_t *engine, const endpoint_t *endpoint)
+{
+    struct sockaddr_storage server_addr;
+    socklen_t addr_len;
+    if (endpoint_sockaddr(endpoint, &server_addr, &addr_len) != 0)
+        return NULL;
+    int sock = socket(endpoint->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        perror("sock creation failed");
+        return NULL;
+    }
+    engine_conn_state_t state = ENGINE_CONN_IDLE;
+    if (connect(sock, (struct sockaddr *)&server_addr, addr_len) < 0)
+    {
+        if (errno != EINPROGRESS)
+        {
+            perror("Connection failed");
+            close(sock);
+            return NULL;
+        }
+        state = ENGINE_CONN_CONNECTING;
+    }
+    engine_conn_t *conn = engine_add(engine, sock, 1, state,
+                                     state == ENGINE_CONN_CONNECTING ? EPOLLOUT : EPOLLIN);
+    if (conn == NULL)
+        close(sock);
+    return conn;
+}
+
+engine_conn_t *engine_adopt(engine_t *engine, int sock)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0)
+        return NULL;
+    engine_conn_t *conn = engine_add(engine, sock, 0, ENGINE_CONN_IDLE, EPOLLIN);
+    if (conn == NULL)
+    {
+        fcntl(sock, F_SETFL, flags);
+        return NULL;
+    }
+    conn->saved_flags = flags;
+    return conn;
+}
+
+void engine_release(engine_conn_t *conn)
+{
+    if (conn == NULL || conn->state == ENGINE_CONN_FREE)
+        return;
+    engine_conn_fail(conn, ENGINE_ERROR);
+    if (conn->owned)
+        close(conn->socket);
+    else
+        fcntl(conn->socket, F_SETFL, conn->saved_flags);
+    conn->state = ENGINE_CONN_FREE;
+}
+
+static int engine_submit(engine_conn_t *conn, engine_request_t *req, char *response,
+                         size_t response_size, long timeout_ms,
+                         engine_callback_t callback, void *arg)
+{
+    req->response = response;
+    req->response_size = response_size;
+    req->response_len = 0;
+    req->response[0] = '\0';
+    req->timeout_ms = timeout_ms;
+    req->callback = callback;
+    req->arg = arg;
+    req->status = 0;
+    req->result = ENGINE_ERROR;
+    req->done = 0;
+    http_parser_init(&req->parser);
+    req->deadline_ms = timeout_ms > 0 ? engine_now_ms() + timeout_ms : 0;
+    req->conn = conn;
+    req->next = NULL;
+
+    if (conn->tail != NULL)
+        conn->tail->next = req;
+    else
+        conn->head = req;
+    conn->tail = req;
+    conn->engine->inflight++;
+    engine_arm_timer(conn->engine, req->deadline_ms);
+    engine_conn_start(conn);
+    return 0;
+}
+
+int engine_submit_POST(engine_conn_t *conn, engine_request_t *req, const post_template_t *tpl,
+                       const char *body, size_t body_len, char *response, size_t response_size,
+                       long timeout_ms, engine_callback_t callback, void *arg)
+{
+    if (conn == NULL || req == NULL || tpl == NULL || response == NULL || response_size < 2 ||
+        conn->state == ENGINE_CONN_FREE || conn->state == ENGINE_CONN_DEAD)
+        return -1;
+
+    int length_len = snprintf(req->header, sizeof(req->header), "%zu\r\n\r\n", body_len);
+    if (length_len < 0)
+        return -1;
+    req->iov[0].iov_base = (void *)tpl->header;
+    req->iov[0].iov_len = tpl->header_len;
+    req->iov[1].iov_base = req->header;
+    req->iov[1].iov_len = length_len;
+    req->iov[2].iov_base = (void *)body;
+    req->iov[2].iov_len = body_len;
+    req->iovcnt = 3;
+    return engine_submit(conn, req, response, response_size, timeout_ms, callback, arg);
+}
+
+int engine_submit_GET(engine_conn_t *conn, engine_request_t *req, const char *path,
+                      const char *host, char *response, size_t response_size,
+                      long timeout_ms, engine_callback_t callback, void *arg)
+{
+    if (conn == NULL || req == NULL || response == NULL || response_size < 2 ||
+        conn->state == ENGINE_CONN_FREE || conn->state == ENGINE_CONN_DEAD)
+        return -1;
+
+    int len = snprintf(req->header, sizeof(req->header), "GET %s HTTP/1.1\r\n"
+                                                         "Host: %s\r\n"
+                                                         "\r\n",
+                       path, host);
+    if (len < 0 || (size_t)len >= sizeof(req->header))
+        return -1;
+    // Unused slots are skipped by starting the write at iov[3 - iovcnt]
+    req->iov[2].iov_base = req->header;
+    req->iov[2].iov_len = len;
+    req->iovcnt = 1;
+    return engine_submit(conn, req, response, response_size, timeout_ms, callback, arg);
+}
+
+int engine_run(engine_t *engine, int timeout_ms)
+{
+    struct epoll_event events[ENGINE_MAX_EVENTS];
+    int ready = epoll_wait(engine->epfd, events, ENGINE_MAX_EVENTS, timeout_ms);
+    if (ready < 0)
+        return errno == EINTR ? 0 : -1;
+
+    int completed = 0;
+    for (int i = 0; i < ready; i++)
+    {
+        if (events[i].data.ptr == engine)
+        {
+            uint64_t expirations;
+            if (read(engine->timerfd, &expirations, sizeof(expirations)) > 0)
+                completed += engine_expire(engine);
+            continue;
+        }
+        engine_conn_t *conn = (engine_conn_t *)events[i].data.ptr;
+        uint32_t ev = events[i].events;
+
+        if (conn->state == ENGINE_CONN_CONNECTING)
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(conn->socket, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0)
+            {
+                engine_conn_fail(conn, ENGINE_ERROR);
+                continue;
+            }
+            conn->state = ENGINE_CONN_IDLE;
+            engine_watch(conn, EPOLLIN);
+            engine_conn_start(conn);
+            continue;
+        }
+        if (conn->state == ENGINE_CONN_WRITING && (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            engine_conn_write(conn);
+        if (conn->state == ENGINE_CONN_READING && (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            completed += engine_conn_read(conn);
+        else if (conn->state == ENGINE_CONN_IDLE && (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            // Nothing is expected on an idle connection, it was closed or broke
+            engine_conn_fail(conn, ENGINE_ERROR);
+    }
+    return completed;
+}
+
+int engine_wait(engine_t *engine, engine_request_t *req)
+{
+    while (!req->done)
+    {
+        if (engine_run(engine, -1) < 0)
+        {
+            if (req->conn != NULL)
+                engine_conn_fail(req->conn, ENGINE_ERROR);
+            break;
+        }
+    }
+    return req->result;
+}
+
+void engine_destroy(engine_t *engine)
+{
+    if (engine->conns != NULL)
+    {
+        for (size_t i = 0; i < engine->max_conns; i++)
+            engine_release(&engine->conns[i]);
+        free(engine->conns);
+        engine->conns = NULL;
+    }
+    if (engine->timerfd >= 0)
+        close(engine->timerfd);
+    if (engine->epfd >= 0)
+        close(engine->epfd);
+    engine->timerfd = engine->epfd = -1;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file engine.h
+ * @brief Asynchronous HTTP client engine built on epoll
+ *
+ * The engine multiplexes many non-blocking server connections from a single
+ * thread. Requests are queued per connection, sent when the connection is
+ * free and completed through a callback once their response has arrived,
+ * failed or timed out. Timeouts are driven by a single timerfd armed to the
+ * earliest pending deadline.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "send.h"
+
+#define ENGINE_MAX_CONNECTIONS 1024
+#define ENGINE_MAX_EVENTS 64
+
+#define ENGINE_OK 0
+#define ENGINE_ERROR -1
+#define ENGINE_TIMEOUT -2
+
+struct engine;
+struct engine_conn;
+struct engine_request;
+
+/**
+ * @brief Called once when a request completes, fails or times out
+ *
+ * The callback may submit new requests, also on the same connection.
+ */
+typedef void (*engine_callback_t)(struct engine_request *req, void *arg);
+
+/**
+ * @brief State of an engine connection
+ */
+typedef enum engine_conn_state
+{
+    ENGINE_CONN_FREE,       /**< Slot not in use */
+    ENGINE_CONN_CONNECTING, /**< Non-blocking connect in progress */
+    ENGINE_CONN_IDLE,       /**< Connected, no request in flight */
+    ENGINE_CONN_WRITING,    /**< Sending the current request */
+    ENGINE_CONN_READING,    /**< Waiting for the current response */
+    ENGINE_CONN_DEAD        /**< Failed or closed by the server */
+} engine_conn_state_t;
+
+/**
+ * @brief A request handled by the engine
+ *
+ * The caller owns the struct and the buffers it points to until the
+ * callback has run (or done is set).
+ */
+typedef struct engine_request
+{
+    /* Filled in by the caller through engine_submit_POST/GET */
+    char *response;             /**< Buffer for the full response */
+    size_t response_size;       /**< Size of the response buffer */
+    long timeout_ms;            /**< Time allowed from submission, 0 for none */
+    engine_callback_t callback; /**< Completion callback, may be NULL */
+    void *arg;                  /**< Passed to the callback */
+
+    /* Filled in by the engine */
+    size_t response_len; /**< Bytes of the response, NUL-terminated */
+    int status;          /**< HTTP status code, 0 if no response */
+    int result;          /**< ENGINE_OK, ENGINE_ERROR or ENGINE_TIMEOUT */
+    int done;            /**< Set once the request has completed */
+    http_parser_t parser; /**< Parsed response, its views point into response */
+
+    /* Engine internals */
+    char header[HEADER_TEMPLATE_SIZE];
+    struct iovec iov[3];
+    int iovcnt;
+    uint64_t deadline_ms;
+    struct engine_conn *conn;
+    struct engine_request *next;
+} engine_request_t;
+
+/**
+ * @brief A connection managed by the engine
+ */
+typedef struct engine_conn
+{
+    int socket;
+    int owned;     /**< The engine closes the socket when done with it */
+    int saved_flags; /**< File status flags of an adopted socket */
+    engine_conn_state_t state;
+    engine_request_t *current; /**< Request being sent or received */
+    engine_request_t *head;    /**< Requests waiting for this connection */
+    engine_request_t *tail;
+    struct engine *engine;
+} engine_conn_t;
+
+/**
+ * @brief Struct holding the event loop and its connections
+ */
+typedef struct engine
+{
+    int epfd;
+    int timerfd;
+    engine_conn_t *conns;
+    size_t max_conns;
+    size_t inflight;       /**< Requests submitted and not yet completed */
+    uint64_t next_deadline; /**< Deadline the timer is armed for, 0 if disarmed */
+} engine_t;
+
+/**
+ * @brief Creates the epoll instance and timer of an engine
+ *
+ * @param engine Pointer to the engine to initialize
+ * @param max_conns Maximum number of connections, at most ENGINE_MAX_CONNECTIONS
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int engine_init(engine_t *engine, size_t max_conns);
+
+/**
+ * @brief Starts a non-blocking connect to the server
+ *
+ * Requests can be submitted right away, they are sent once connected.
+ *
+ * @param engine Pointer to the engine
+ * @param endpoint The server, TCP or Unix domain socket
+ *
+ * @return Returns the connection, NULL on failure
+ */
+engine_conn_t *engine_connect(engine_t *engine, const endpoint_t *endpoint);
+
+/**
+ * @brief Hands an already connected socket to the engine
+ *
+ * The socket is switched to non-blocking mode until engine_release().
+ *
+ * @param engine Pointer to the engine
+ * @param sock The connected socket, still owned by the caller
+ *
+ * @return Returns the connection, NULL on failure
+ */
+engine_conn_t *engine_adopt(engine_t *engine, int sock);
+
+/**
+ * @brief Removes a connection from the engine
+ *
+ * Pending requests fail with ENGINE_ERROR. Owned sockets are closed, adopted
+ * sockets get their original flags back.
+ *
+ * @param conn The connection to release
+ */
+void engine_release(engine_conn_t *conn);
+
+/**
+ * @brief Queues a POST request on a connection
+ *
+ * @param conn The connection to send on
+ * @param req The request to fill in and queue
+ * @param tpl The pre-rendered POST header, borrowed until completion
+ * @param body The body, borrowed until completion
+ * @param body_len The length of the body
+ * @param response Buffer for the response
+ * @param response_size Size of the response buffer
+ * @param timeout_ms Time allowed for the request, 0 for none
+ * @param callback Completion callback, may be NULL
+ * @param arg Passed to the callback
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int engine_submit_POST(engine_conn_t *conn, engine_request_t *req, const post_template_t *tpl,
+                       const char *body, size_t body_len, char *response, size_t response_size,
+                       long timeout_ms, engine_callback_t callback, void *arg);
+
+/**
+ * @brief Queues a GET request on a connection
+ *
+ * @param conn The connection to send on
+ * @param req The request to fill in and queue
+ * @param path The path to request
+ * @param host The server host
+ * @param response Buffer for the response
+ * @param response_size Size of the response buffer
+ * @param timeout_ms Time allowed for the request, 0 for none
+ * @param callback Completion callback, may be NULL
+ * @param arg Passed to the callback
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int engine_submit_GET(engine_conn_t *conn, engine_request_t *req, const char *path,
+                      const char *host, char *response, size_t response_size,
+                      long timeout_ms, engine_callback_t callback, void *arg);
+
+/**
+ * @brief Waits for events once and processes them
+ *
+ * @param engine Pointer to the engine
+ * @param timeout_ms Maximum time to wait, -1 to wait forever
+ *
+ * @return Returns the number of requests completed, -1 on failure
+ */
+int engine_run(engine_t *engine, int timeout_ms);
+
+/**
+ * @brief Runs the event loop until a request has completed
+ *
+ * @param engine Pointer to the engine
+ * @param req The request to wait for
+ *
+ * @return Returns the result of the request
+ */
+int engine_wait(engine_t *engine, engine_request_t *req);
+
+/**
+ * @brief Releases all connections and closes the engine
+ *
+ * @param engine Pointer to the engine
+ */
+void engine_destroy(engine_t *engine);
+
+/**
+ * @brief Returns the current monotonic time in milliseconds
+ */
+uint64_t engine_now_ms();
+
+#endif
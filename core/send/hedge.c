@@ -0,0 +1,173 @@
+#include "hedge.h"
+#include "../utils/buffer.h"
+
+#include <time.h>
+
+static uint64_t hedge_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int hedge_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int hedge_init(hedge_t *hedge, int percentile)
+{
+    if (hedge == NULL || percentile < 1 || percentile > 99)
+        return -1;
+    memset(hedge, 0, sizeof(hedge_t));
+    hedge->percentile = percentile;
+    if (engine_init(&hedge->engine, 2) != 0)
+        return -1;
+    return 0;
+}
+
+void hedge_record(hedge_t *hedge, uint64_t latency_us)
+{
+    hedge->samples[hedge->next] = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    hedge->next = (hedge->next + 1) % HEDGE_SAMPLES;
+    if (hedge->count < HEDGE_SAMPLES)
+        hedge->count++;
+    // Sorting the window is cheap, but not worth doing after every request
+    if (hedge->count < HEDGE_MIN_SAMPLES || ++hedge->since_recompute < HEDGE_RECOMPUTE)
+        return;
+    hedge->since_recompute = 0;
+    uint32_t sorted[HEDGE_SAMPLES];
+    memcpy(sorted, hedge->samples, hedge->count * sizeof(uint32_t));
+    qsort(sorted, hedge->count, sizeof(uint32_t), hedge_compare);
+    hedge->threshold_us = sorted[(hedge->count - 1) * hedge->percentile / 100];
+}
+
+// Send the request a second time on another idle connection
+static int hedge_launch(hedge_t *hedge, conn_pool_t *pool, conn_t **conn, engine_conn_t **econn,
+                        engine_request_t *req, size_t response_size, const char *data,
+                        size_t data_len)
+{
+    if (buffer_reserve(&hedge->spare, &hedge->spare_size, response_size) != 0)
+        return -1;
+    *conn = pool_try_checkout(pool);
+    if (*conn == NULL)
+        return -1;
+    *econn = engine_adopt(&hedge->engine, (*conn)->socket);
+    if (*econn == NULL ||
+        engine_submit_POST(*econn, req, &pool->post, data, data_len, hedge->spare,
+                           response_size, pool->timeout_ms, NULL, NULL) != 0)
+    {
+        engine_release(*econn);
+        pool_checkin(pool, *conn, 1);
+        *conn = NULL;
+        return -1;
+    }
+    hedge->hedged++;
+    return 0;
+}
+
+// Send the request on a checked out connection and hedge it if it is slow
+static int hedge_attempt(hedge_t *hedge, conn_pool_t *pool, conn_t *conn, char *response,
+                         size_t response_size, const char *data, size_t data_len)
+{
+    conn_t *conns[2] = {conn, NULL};
+    engine_conn_t *econns[2] = {NULL, NULL};
+    engine_request_t reqs[2];
+    uint64_t start = hedge_now_us();
+
+    econns[0] = engine_adopt(&hedge->engine, conns[0]->socket);
+    if (econns[0] == NULL ||
+        engine_submit_POST(econns[0], &reqs[0], &pool->post, data, data_len, response,
+                           response_size, pool->timeout_ms, NULL, NULL) != 0)
+    {
+        engine_release(econns[0]);
+        pool_checkin(pool, conns[0], 1);
+        return -1;
+    }
+    hedge->requests++;
+
+    int launched = 1;
+    int winner = -1;
+    uint64_t threshold_us = hedge->threshold_us;
+    for (;;)
+    {
+        int pending = 0;
+        for (int i = 0; i < launched && winner < 0; i++)
+        {
+            if (!reqs[i].done)
+                pending++;
+            else if (reqs[i].result == ENGINE_OK)
+                winner = i;
+        }
+        if (winner >= 0 || pending == 0)
+            break;
+
+        int wait_ms = -1;
+        if (launched == 1 && threshold_us > 0)
+        {
+            uint64_t elapsed = hedge_now_us() - start;
+            if (elapsed >= threshold_us)
+            {
+                if (hedge_launch(hedge, pool, &conns[1], &econns[1], &reqs[1], response_size,
+                                 data, data_len) == 0)
+                    launched = 2;
+                // Hedge at most once, even if no connection was idle
+                threshold_us = 0;
+                continue;
+            }
+            wait_ms = (int)((threshold_us - elapsed + 999) / 1000);
+        }
+        if (engine_run(&hedge->engine, wait_ms) < 0)
+            break;
+    }
+
+    int res = -1;
+    if (winner >= 0)
+    {
+        res = reqs[winner].response_len;
+        if (winner == 1)
+        {
+            memcpy(response, hedge->spare, reqs[1].response_len + 1);
+            hedge->hedge_wins++;
+        }
+        hedge_record(hedge, hedge_now_us() - start);
+    }
+    // The loser may still get its response, so its connection cannot be reused
+    for (int i = 0; i < launched; i++)
+    {
+        int keep_alive = i == winner && reqs[i].parser.keep_alive;
+        engine_release(econns[i]);
+        pool_checkin(pool, conns[i], keep_alive);
+    }
+    return res;
+}
+
+int pool_POST_hedged(hedge_t *hedge, conn_pool_t *pool, char *response, size_t response_size,
+                     const char *data, size_t data_len)
+{
+    int attempts = pool->retry.attempts > 0 ? pool->retry.attempts : 1;
+    int backoffs = 0;
+    for (int attempt = 0; attempt < attempts; attempt++)
+    {
+        conn_t *conn = pool_checkout(pool);
+        if (conn == NULL)
+            return -1;
+        int reused = conn->requests > 0;
+        int res = hedge_attempt(hedge, pool, conn, response, response_size, data, data_len);
+        if (res >= 0)
+            return res;
+        if (!pool_retry_wait(pool, attempt, reused, &backoffs))
+            break;
+    }
+    return -1;
+}
+
+void hedge_destroy(hedge_t *hedge)
+{
+    engine_destroy(&hedge->engine);
+    free(hedge->spare);
+    hedge->spare = NULL;
+    hedge->spare_size = 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file hedge.h
+ * @brief Hedged POST requests on pooled connections
+ *
+ * A request that takes longer than a percentile of the recent latencies is
+ * sent again on a second pooled connection, and whichever response arrives
+ * first is used. This cuts the tail latency caused by a single slow
+ * connection or server thread at the cost of a few duplicate requests. The
+ * connection of the losing request is closed, since its response may still
+ * arrive, and reconnected by the pool.
+ *
+ * @note A hedge_t is used by one thread at a time.
+ * @note This file is part of the client core module.
+ */
+#ifndef HEDGE_H
+#define HEDGE_H
+
+#include "pool.h"
+#include "engine.h"
+
+#define HEDGE_SAMPLES 256
+#define HEDGE_MIN_SAMPLES 20
+#define HEDGE_RECOMPUTE 16
+#define HEDGE_DEFAULT_PERCENTILE 95
+
+/**
+ * @brief Latency history and event loop for hedged requests
+ */
+typedef struct hedge
+{
+    int percentile;                  /**< Percentile after which a request is hedged */
+    uint32_t samples[HEDGE_SAMPLES]; /**< Recent latencies in microseconds, a ring */
+    size_t count;                    /**< Samples recorded, at most HEDGE_SAMPLES */
+    size_t next;                     /**< Ring position of the next sample */
+    size_t since_recompute;          /**< Samples since the threshold was computed */
+    uint32_t threshold_us;           /**< Hedge threshold, 0 until enough samples */
+    size_t requests;                 /**< Requests sent */
+    size_t hedged;                   /**< Requests that were sent a second time */
+    size_t hedge_wins;               /**< Hedged requests answered on the second connection first */
+    engine_t engine;
+    char *spare;       /**< Response buffer of the second request */
+    size_t spare_size;
+} hedge_t;
+
+/**
+ * @brief Prepares hedging
+ *
+ * @param hedge Pointer to the hedge to initialize
+ * @param percentile Latency percentile after which a request is hedged, 1 to 99
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int hedge_init(hedge_t *hedge, int percentile);
+
+/**
+ * @brief Records the latency of a request
+ *
+ * @param hedge Pointer to the hedge
+ * @param latency_us Latency in microseconds
+ */
+void hedge_record(hedge_t *hedge, uint64_t latency_us);
+
+/**
+ * @brief Sends a POST request to the pool path, hedged on a second connection
+ *
+ * The first request is bounded by the pool's request timeout. If it is still
+ * unanswered at the hedge threshold and another connection is idle, the
+ * request is sent again there. No hedge is sent until HEDGE_MIN_SAMPLES
+ * latencies have been recorded. When neither request is answered, the
+ * request is retried like pool_POST() does, under the pool's retry policy.
+ *
+ * @param hedge Pointer to the hedge
+ * @param pool Pointer to the pool, should have at least two connections
+ * @param response A pointer to a buffer where the response will be stored
+ * @param response_size The size of the response buffer
+ * @param data The body of the request, sent in place
+ * @param data_len The length of the body
+ *
+ * @return Returns the number of bytes received, -1 on failure
+ */
+int pool_POST_hedged(hedge_t *hedge, conn_pool_t *pool, char *response, size_t response_size,
+                     const char *data, size_t data_len);
+
+/**
+ * @brief Frees the resources of a hedge
+ *
+ * @param hedge Pointer to the hedge
+ */
+void hedge_destroy(hedge_t *hedge);
+
+#endif
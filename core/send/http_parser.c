@@ -0,0 +1,322 @@
+#include <string.h>
+#include <strings.h>
+
+#include "http_parser.h"
+
+void http_parser_init(http_parser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = HTTP_STATE_STATUS_LINE;
+    parser->content_length = -1;
+}
+
+// Find the end of the line starting at parser->offset, without rescanning bytes
+static int http_parser_line(http_parser_t *parser, const char *buffer, size_t len,
+                            size_t *line_len, size_t *next)
+{
+    size_t from = parser->scan > parser->offset ? parser->scan : parser->offset;
+    const char *nl = memchr(buffer + from, '\n', len - from);
+    if (nl == NULL)
+    {
+        parser->scan = len;
+        return 0;
+    }
+    size_t end = nl - buffer;
+    *next = end + 1;
+    if (end > parser->offset && buffer[end - 1] == '\r')
+        end--;
+    *line_len = end - parser->offset;
+    return 1;
+}
+
+// Check if a comma separated header value contains a token (case-insensitive)
+static int http_has_token(const char *value, size_t len, const char *token)
+{
+    size_t token_len = strlen(token);
+    for (size_t i = 0; i + token_len <= len; i++)
+    {
+        if (strncasecmp(value + i, token, token_len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int http_parser_fail(http_parser_t *parser)
+{
+    parser->state = HTTP_STATE_ERROR;
+    return HTTP_PARSE_ERROR;
+}
+
+static int http_parser_done(http_parser_t *parser, const char *buffer)
+{
+    parser->headers.ptr = buffer + parser->headers_start;
+    parser->body.ptr = buffer + parser->body_start;
+    parser->body.len = parser->body_end - parser->body_start;
+    parser->state = HTTP_STATE_DONE;
+    return HTTP_PARSE_DONE;
+}
+
+static int http_parse_status_line(http_parser_t *parser, const char *line, size_t len)
+{
+    // "HTTP/1.x SSS"
+    if (len < 12 || strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ')
+        return -1;
+    int status = 0;
+    for (int i = 9; i < 12; i++)
+    {
+        if (line[i] < '0' || line[i] > '9')
+            return -1;
+        status = status * 10 + (line[i] - '0');
+    }
+    parser->status = status;
+    // HTTP/1.1 connections are persistent unless the server says otherwise
+    parser->keep_alive = line[7] != '0';
+    return 0;
+}
+
+static int http_parse_header_line(http_parser_t *parser, const char *line, size_t len)
+{
+    const char *colon = memchr(line, ':', len);
+    if (colon == NULL)
+        return -1;
+    size_t name_len = colon - line;
+    const char *value = colon + 1;
+    size_t value_len = len - name_len - 1;
+    while (value_len > 0 && (*value == ' ' || *value == '\t'))
+    {
+        value++;
+        value_len--;
+    }
+    while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t'))
+        value_len--;
+
+    if (name_len == 14 && strncasecmp(line, "Content-Length", 14) == 0)
+    {
+        if (value_len == 0)
+            return -1;
+        long long length = 0;
+        for (size_t i = 0; i < value_len; i++)
+        {
+            if (value[i] < '0' || value[i] > '9' || length > (1LL << 48))
+                return -1;
+            length = length * 10 + (value[i] - '0');
+        }
+        if (parser->content_length >= 0 && parser->content_length != length)
+            return -1;
+        parser->content_length = length;
+    }
+    else if (name_len == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0)
+    {
+        if (http_has_token(value, value_len, "chunked"))
+            parser->chunked = 1;
+    }
+    else if (name_len == 10 && strncasecmp(line, "Connection", 10) == 0)
+    {
+        if (http_has_token(value, value_len, "close"))
+            parser->keep_alive = 0;
+        else if (http_has_token(value, value_len, "keep-alive"))
+            parser->keep_alive = 1;
+    }
+    return 0;
+}
+
+// Decide how the body is delimited once the headers are complete
+static int http_parser_headers_done(http_parser_t *parser, const char *buffer)
+{
+    int status = parser->status;
+    parser->body_start = parser->offset;
+    parser->body_end = parser->offset;
+    if (status >= 100 && status < 200 && status != 101)
+    {
+        // Interim response, the final one follows on the same connection
+        size_t offset = parser->offset;
+        http_parser_init(parser);
+        parser->offset = offset;
+        return HTTP_PARSE_MORE;
+    }
+    if (status == 101 || status == 204 || status == 304)
+        return http_parser_done(parser, buffer);
+    if (parser->chunked)
+    {
+        parser->state = HTTP_STATE_CHUNK_SIZE;
+        return HTTP_PARSE_MORE;
+    }
+    if (parser->content_length >= 0)
+    {
+        parser->remaining = parser->content_length;
+        parser->state = HTTP_STATE_BODY_LENGTH;
+        return HTTP_PARSE_MORE;
+    }
+    // Neither a length nor chunks, the body runs until the server closes
+    parser->keep_alive = 0;
+    parser->state = HTTP_STATE_BODY_CLOSE;
+    return HTTP_PARSE_MORE;
+}
+
+static int http_parse_chunk_size(http_parser_t *parser, const char *line, size_t len)
+{
+    size_t size = 0;
+    size_t i = 0;
+    for (; i < len; i++)
+    {
+        char c = line[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            break;
+        if (size >> (sizeof(size) * 8 - 4) != 0)
+            return -1;
+        size = (size << 4) | digit;
+    }
+    // At least one digit, optionally followed by chunk extensions
+    if (i == 0 || (i < len && line[i] != ';' && line[i] != ' ' && line[i] != '\t'))
+        return -1;
+    parser->remaining = size;
+    parser->state = size == 0 ? HTTP_STATE_TRAILER : HTTP_STATE_CHUNK_DATA;
+    return 0;
+}
+
+int http_parser_feed(http_parser_t *parser, char *buffer, size_t len)
+{
+    while (1)
+    {
+        size_t line_len, next;
+        size_t n;
+        const char *line = buffer + parser->offset;
+        switch (parser->state)
+        {
+        case HTTP_STATE_STATUS_LINE:
+            if (!http_parser_line(parser, buffer, len, &line_len, &next))
+                return HTTP_PARSE_MORE;
+            if (http_parse_status_line(parser, line, line_len) != 0)
+                return http_parser_fail(parser);
+            parser->offset = next;
+            parser->headers_start = next;
+            parser->state = HTTP_STATE_HEADER_LINE;
+            break;
+
+        case HTTP_STATE_HEADER_LINE:
+            if (!http_parser_line(parser, buffer, len, &line_len, &next))
+                return HTTP_PARSE_MORE;
+            if (line_len == 0)
+            {
+                parser->headers.len = parser->offset - parser->headers_start;
+                parser->offset = next;
+                int res = http_parser_headers_done(parser, buffer);
+                if (res != HTTP_PARSE_MORE)
+                    return res;
+                break;
+            }
+            if (http_parse_header_line(parser, line, line_len) != 0)
+                return http_parser_fail(parser);
+            parser->offset = next;
+            break;
+
+        case HTTP_STATE_BODY_LENGTH:
+            n = len - parser->offset;
+            if (n > parser->remaining)
+                n = parser->remaining;
+            parser->offset += n;
+            parser->remaining -= n;
+            parser->body_end = parser->offset;
+            if (parser->remaining > 0)
+                return HTTP_PARSE_MORE;
+            return http_parser_done(parser, buffer);
+
+        case HTTP_STATE_BODY_CLOSE:
+            parser->offset = len;
+            parser->body_end = len;
+            return HTTP_PARSE_MORE;
+
+        case HTTP_STATE_CHUNK_SIZE:
+            if (!http_parser_line(parser, buffer, len, &line_len, &next))
+                return HTTP_PARSE_MORE;
+            if (http_parse_chunk_size(parser, line, line_len) != 0)
+                return http_parser_fail(parser);
+            parser->offset = next;
+            break;
+
+        case HTTP_STATE_CHUNK_DATA:
+            n = len - parser->offset;
+            if (n > parser->remaining)
+                n = parser->remaining;
+            // Decode in place so the body stays contiguous
+            if (parser->body_end != parser->offset)
+                memmove(buffer + parser->body_end, buffer + parser->offset, n);
+            parser->body_end += n;
+            parser->offset += n;
+            parser->remaining -= n;
+            if (parser->remaining > 0)
+                return HTTP_PARSE_MORE;
+            parser->state = HTTP_STATE_CHUNK_DATA_END;
+            break;
+
+        case HTTP_STATE_CHUNK_DATA_END:
+            if (!http_parser_line(parser, buffer, len, &line_len, &next))
+                return HTTP_PARSE_MORE;
+            if (line_len != 0)
+                return http_parser_fail(parser);
+            parser->offset = next;
+            parser->state = HTTP_STATE_CHUNK_SIZE;
+            break;
+
+        case HTTP_STATE_TRAILER:
+            if (!http_parser_line(parser, buffer, len, &line_len, &next))
+                return HTTP_PARSE_MORE;
+            parser->offset = next;
+            if (line_len == 0)
+                return http_parser_done(parser, buffer);
+            break;
+
+        case HTTP_STATE_DONE:
+            return HTTP_PARSE_DONE;
+
+        case HTTP_STATE_ERROR:
+        default:
+            return HTTP_PARSE_ERROR;
+        }
+    }
+}
+
+int http_parser_eof(http_parser_t *parser, char *buffer)
+{
+    if (parser->state == HTTP_STATE_BODY_CLOSE)
+        return http_parser_done(parser, buffer);
+    if (parser->state == HTTP_STATE_DONE)
+        return HTTP_PARSE_DONE;
+    return http_parser_fail(parser);
+}
+
+int http_parser_header(const http_parser_t *parser, const char *name, http_view_t *value)
+{
+    if (parser->headers.ptr == NULL)
+        return 0;
+    size_t name_len = strlen(name);
+    const char *line = parser->headers.ptr;
+    const char *end = parser->headers.ptr + parser->headers.len;
+    while (line < end)
+    {
+        const char *nl = memchr(line, '\n', end - line);
+        const char *line_end = nl != NULL ? nl : end;
+        if ((size_t)(line_end - line) > name_len && line[name_len] == ':' &&
+            strncasecmp(line, name, name_len) == 0)
+        {
+            const char *v = line + name_len + 1;
+            while (v < line_end && (*v == ' ' || *v == '\t'))
+                v++;
+            const char *v_end = line_end;
+            while (v_end > v && (v_end[-1] == '\r' || v_end[-1] == ' ' || v_end[-1] == '\t'))
+                v_end--;
+            value->ptr = v;
+            value->len = v_end - v;
+            return 1;
+        }
+        line = line_end + 1;
+    }
+    return 0;
+}
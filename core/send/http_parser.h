@@ -0,0 +1,125 @@
+/**
+ * @file http_parser.h
+ * @brief Incremental, allocation-free HTTP/1.1 response parser
+ *
+ * The parser is fed the receive buffer every time more bytes have arrived and
+ * resumes where it stopped, so a response that straddles several packets is
+ * scanned exactly once. It parses the status line, the headers it needs
+ * (case-insensitive), Content-Length, chunked and close-delimited bodies and
+ * the keep-alive semantics of the response.
+ *
+ * Results are views into the receive buffer. Chunked bodies are decoded in
+ * place, so the body is always one contiguous view.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+
+#define HTTP_PARSE_ERROR -1
+#define HTTP_PARSE_MORE 0
+#define HTTP_PARSE_DONE 1
+
+/**
+ * @brief A view into the receive buffer, not NUL-terminated
+ */
+typedef struct http_view
+{
+    const char *ptr;
+    size_t len;
+} http_view_t;
+
+/**
+ * @brief Parser states
+ */
+typedef enum http_parse_state
+{
+    HTTP_STATE_STATUS_LINE,
+    HTTP_STATE_HEADER_LINE,
+    HTTP_STATE_BODY_LENGTH,
+    HTTP_STATE_BODY_CLOSE,
+    HTTP_STATE_CHUNK_SIZE,
+    HTTP_STATE_CHUNK_DATA,
+    HTTP_STATE_CHUNK_DATA_END,
+    HTTP_STATE_TRAILER,
+    HTTP_STATE_DONE,
+    HTTP_STATE_ERROR
+} http_parse_state_t;
+
+/**
+ * @brief State of one response being parsed
+ *
+ * Offsets are relative to the start of the buffer passed to http_parser_feed(),
+ * so the buffer may be moved (e.g. grown with realloc) between calls. The views
+ * are only set once the response is done.
+ */
+typedef struct http_parser
+{
+    http_parse_state_t state;
+    size_t offset;     /**< Bytes of the buffer consumed so far */
+    size_t scan;       /**< Where the search for the end of the current line resumes */
+    size_t headers_start; /**< Offset of the first header line */
+    size_t body_start; /**< Offset of the first body byte */
+    size_t body_end;   /**< Offset after the last decoded body byte */
+    size_t remaining;  /**< Bytes left of the body or current chunk */
+
+    int status;              /**< HTTP status code */
+    int keep_alive;          /**< 1 if the connection can be reused */
+    int chunked;             /**< Transfer-Encoding: chunked */
+    long long content_length; /**< Content-Length, -1 if not given */
+    http_view_t headers;     /**< Raw header block without the status line, set once done */
+    http_view_t body;        /**< Decoded body, set once the response is done */
+} http_parser_t;
+
+/**
+ * @brief Prepares a parser for a new response
+ *
+ * @param parser Pointer to the parser
+ */
+void http_parser_init(http_parser_t *parser);
+
+/**
+ * @brief Feeds the parser with the bytes received so far
+ *
+ * The buffer must start with the response and hold every byte received for
+ * it, len is the total number of bytes in it. Only the bytes after the
+ * previous call are scanned. Chunked bodies are decoded in place, which
+ * overwrites the chunk framing in the buffer.
+ *
+ * @param parser Pointer to the parser
+ * @param buffer The receive buffer
+ * @param len Number of bytes in the buffer
+ *
+ * @return HTTP_PARSE_DONE when the response is complete (parser->offset is
+ *         then its length in the buffer), HTTP_PARSE_MORE if more bytes are
+ *         needed, HTTP_PARSE_ERROR on a malformed response
+ */
+int http_parser_feed(http_parser_t *parser, char *buffer, size_t len);
+
+/**
+ * @brief Tells the parser that the server closed the connection
+ *
+ * Completes responses whose body is delimited by the connection close.
+ *
+ * @param parser Pointer to the parser
+ * @param buffer The receive buffer
+ *
+ * @return HTTP_PARSE_DONE if the response is complete, HTTP_PARSE_ERROR if it
+ *         was cut off
+ */
+int http_parser_eof(http_parser_t *parser, char *buffer);
+
+/**
+ * @brief Looks up a header of a parsed response
+ *
+ * @param parser Pointer to a parser that has parsed a whole response
+ * @param name The header name, matched case-insensitively
+ * @param value Set to the header value, without surrounding whitespace
+ *
+ * @return Returns 1 if the header was found, 0 otherwise
+ */
+int http_parser_header(const http_parser_t *parser, const char *name, http_view_t *value);
+
+#endif
@@ -0,0 +1,243 @@
+#include "load.h"
+
+#include <math.h>
+#include <time.h>
+
+static uint64_t load_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int load_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Gap between two arrivals in microseconds
+static double load_gap_us(load_t *load)
+{
+    double mean = 1000000.0 / load->rate;
+    if (load->arrival == LOAD_FIXED)
+        return mean;
+    // Inverse transform of a uniform sample in (0, 1]
+    double u = (rand_r(&load->seed) + 1.0) / ((double)RAND_MAX + 1.0);
+    return -log(u) * mean;
+}
+
+static void load_done(engine_request_t *req, void *arg)
+{
+    load_slot_t *slot = (load_slot_t *)arg;
+    load_t *load = slot->load;
+    uint64_t now = load_now_us();
+    slot->busy = 0;
+    // Failed and timed-out requests are measured too, dropping them would hide stalls
+    load->latencies_us[load->measured] = now - slot->intended_us;
+    load->service_us[load->measured] = now - slot->sent_us;
+    load->measured++;
+    if (req->result != ENGINE_OK)
+        load->failed++;
+    else
+        load->completed++;
+}
+
+// Find an idle connection, reconnecting the ones that were closed
+static load_slot_t *load_idle_slot(load_t *load)
+{
+    for (size_t i = 0; i < load->num_slots; i++)
+    {
+        load_slot_t *slot = &load->slots[i];
+        if (slot->busy)
+            continue;
+        if (slot->conn != NULL && slot->conn->state == ENGINE_CONN_DEAD)
+        {
+            engine_release(slot->conn);
+            slot->conn = NULL;
+        }
+        if (slot->conn == NULL)
+            slot->conn = engine_connect(&load->engine, &load->endpoint);
+        if (slot->conn != NULL)
+            return slot;
+    }
+    return NULL;
+}
+
+int load_init(load_t *load, const endpoint_t *endpoint, const char *path,
+              const char *content_type, size_t connections, double rate, load_arrival_t arrival)
+{
+    if (load == NULL || endpoint == NULL || content_type == NULL || connections == 0 ||
+        connections > LOAD_MAX_CONNECTIONS || !(rate > 0))
+    {
+        fprintf(stderr, "Invalid load configuration\n");
+        return -1;
+    }
+    memset(load, 0, sizeof(load_t));
+    load->endpoint = *endpoint;
+    load->rate = rate;
+    load->arrival = arrival;
+    load->timeout_ms = REQUEST_TIMEOUT_MS;
+    load->seed = (unsigned int)time(NULL);
+    if (post_template_init(&load->post, path, load->endpoint.host, content_type) != 0)
+    {
+        fprintf(stderr, "Could not render POST header\n");
+        return -1;
+    }
+    if (engine_init(&load->engine, connections) != 0)
+        return -1;
+
+    load->slots = calloc(connections, sizeof(load_slot_t));
+    if (load->slots == NULL)
+    {
+        fprintf(stderr, "Could not allocate load connections\n");
+        engine_destroy(&load->engine);
+        return -1;
+    }
+    load->num_slots = connections;
+    for (size_t i = 0; i < connections; i++)
+    {
+        load_slot_t *slot = &load->slots[i];
+        slot->load = load;
+        slot->response = malloc(BUFFER_SIZE);
+        slot->conn = engine_connect(&load->engine, endpoint);
+        if (slot->response == NULL || slot->conn == NULL)
+        {
+            fprintf(stderr, "Could not open load connection %zu\n", i);
+            load_destroy(load);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int load_run(load_t *load, char *bodies[], const size_t lengths[], size_t num_bodies,
+             size_t total)
+{
+    if (num_bodies == 0)
+        return -1;
+    free(load->latencies_us);
+    free(load->service_us);
+    load->latencies_us = malloc(total * sizeof(uint64_t));
+    load->service_us = malloc(total * sizeof(uint64_t));
+    if (load->latencies_us == NULL || load->service_us == NULL)
+    {
+        fprintf(stderr, "Could not allocate latency samples\n");
+        return -1;
+    }
+    load->measured = 0;
+    load->completed = 0;
+    load->failed = 0;
+    load->sent = 0;
+    load->bodies = num_bodies;
+    load->max_lag_us = 0;
+
+    uint64_t start = load_now_us();
+    double next_intended = start;
+    while (load->sent < total || load->engine.inflight > 0)
+    {
+        uint64_t now = load_now_us();
+        // Send everything that is due; late requests keep their intended time
+        while (load->sent < total && next_intended <= now)
+        {
+            load_slot_t *slot = load_idle_slot(load);
+            if (slot == NULL)
+                break;
+            size_t body = load->sent % num_bodies;
+            slot->intended_us = (uint64_t)next_intended;
+            slot->sent_us = now;
+            if (engine_submit_POST(slot->conn, &slot->req, &load->post, bodies[body],
+                                   lengths[body], slot->response, BUFFER_SIZE,
+                                   load->timeout_ms, load_done, slot) != 0)
+            {
+                load->latencies_us[load->measured] = now - slot->intended_us;
+                load->service_us[load->measured] = 0;
+                load->measured++;
+                load->failed++;
+            }
+            else
+            {
+                slot->busy = 1;
+                if (now - slot->intended_us > load->max_lag_us)
+                    load->max_lag_us = now - slot->intended_us;
+            }
+            load->sent++;
+            next_intended += load_gap_us(load);
+        }
+
+        int wait_ms = -1;
+        if (load->sent < total)
+        {
+            if (load->engine.inflight == 0 && next_intended <= now)
+            {
+                // Nothing in flight and no connection could be opened
+                fprintf(stderr, "Load generator lost every connection\n");
+                return -1;
+            }
+            // Round down and poll for the last millisecond, so sends are not late by design
+            if (next_intended > now)
+                wait_ms = (int)((next_intended - now) / 1000);
+        }
+        if (engine_run(&load->engine, wait_ms) < 0)
+            return -1;
+    }
+    load->elapsed_us = load_now_us() - start;
+    return (int)load->completed;
+}
+
+uint64_t load_percentile(uint64_t *latencies_us, size_t count, double percentile)
+{
+    if (count == 0)
+        return 0;
+    qsort(latencies_us, count, sizeof(uint64_t), load_compare);
+    // Nearest rank
+    size_t rank = (size_t)ceil(percentile / 100.0 * count);
+    if (rank == 0)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+    return latencies_us[rank - 1];
+}
+
+void load_report(load_t *load, FILE *out)
+{
+    double seconds = load->elapsed_us / 1000000.0;
+    fprintf(out, "Open-loop %s arrivals at %.1f req/s: sent %zu, answered %zu, failed %zu in %.2f s (%.1f req/s)\n",
+            load->arrival == LOAD_POISSON ? "Poisson" : "fixed", load->rate, load->sent,
+            load->completed, load->failed, seconds, seconds > 0 ? load->completed / seconds : 0);
+    fprintf(out, "Latency from intended send (ms): p50 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+            load_percentile(load->latencies_us, load->measured, 50) / 1000.0,
+            load_percentile(load->latencies_us, load->measured, 99) / 1000.0,
+            load_percentile(load->latencies_us, load->measured, 99.9) / 1000.0,
+            load_percentile(load->latencies_us, load->measured, 100) / 1000.0);
+    fprintf(out, "Service time from actual send (ms): p50 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+            load_percentile(load->service_us, load->measured, 50) / 1000.0,
+            load_percentile(load->service_us, load->measured, 99) / 1000.0,
+            load_percentile(load->service_us, load->measured, 99.9) / 1000.0,
+            load_percentile(load->service_us, load->measured, 100) / 1000.0);
+    if (load->failed > 0)
+        fprintf(out, "Percentiles include the %zu failed requests up to when they failed\n",
+                load->failed);
+    fprintf(out, "Largest send delay behind schedule: %.3f ms\n", load->max_lag_us / 1000.0);
+    if (load->bodies < load->sent)
+        fprintf(out, "Replayed %zu distinct bodies, the server saw repeated tags and signatures\n",
+                load->bodies);
+}
+
+void load_destroy(load_t *load)
+{
+    for (size_t i = 0; i < load->num_slots; i++)
+    {
+        engine_release(load->slots[i].conn);
+        free(load->slots[i].response);
+    }
+    free(load->slots);
+    load->slots = NULL;
+    load->num_slots = 0;
+    engine_destroy(&load->engine);
+    free(load->latencies_us);
+    free(load->service_us);
+    load->latencies_us = NULL;
+    load->service_us = NULL;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file load.h
+ * @brief Open-loop load generator with coordinated-omission-corrected latencies
+ *
+ * Requests are scheduled at a fixed or Poisson arrival rate, independent of
+ * when responses come back. Each request has an intended send time taken
+ * from the schedule. A request that cannot be sent on time, because every
+ * connection is still waiting for a response, stays due and is sent as soon
+ * as a connection frees up. Its latency is still measured from the intended
+ * send time, so a stalled server shows up in the percentiles instead of
+ * silently slowing the client down (coordinated omission). Requests that
+ * fail or time out count with the time until they failed, so a server that
+ * stalls past the deadline still shows up in the tail.
+ *
+ * The generator runs on the epoll engine with one request in flight per
+ * connection. Connections that fail or are closed by the server are
+ * reconnected between requests.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef LOAD_H
+#define LOAD_H
+
+#include "engine.h"
+
+#define LOAD_MAX_CONNECTIONS 256
+#define LOAD_DEFAULT_CONNECTIONS 16
+#define LOAD_MAX_BODIES 4096              /* Most distinct bodies the client signs before a run */
+#define LOAD_MAX_BODY_BYTES (64 << 20)   /* Stop signing bodies up front past this many bytes */
+
+/**
+ * @brief How arrival times are spaced
+ */
+typedef enum load_arrival
+{
+    LOAD_FIXED,  /**< Exactly 1/rate seconds apart */
+    LOAD_POISSON /**< Exponentially distributed gaps with mean 1/rate */
+} load_arrival_t;
+
+/**
+ * @brief A connection of the generator and the request it carries
+ */
+typedef struct load_slot
+{
+    engine_conn_t *conn;  /**< NULL while disconnected */
+    engine_request_t req;
+    char *response;       /**< Response buffer of BUFFER_SIZE bytes */
+    uint64_t intended_us; /**< Scheduled send time of the request in flight */
+    uint64_t sent_us;     /**< Time the request was actually sent */
+    int busy;             /**< A request is in flight */
+    struct load *load;
+} load_slot_t;
+
+/**
+ * @brief State and results of a load run
+ */
+typedef struct load
+{
+    engine_t engine;
+    endpoint_t endpoint;
+    post_template_t post;
+    load_slot_t *slots;
+    size_t num_slots;
+    double rate;            /**< Requests per second */
+    load_arrival_t arrival;
+    long timeout_ms;        /**< Deadline of each request from its actual send */
+    unsigned int seed;      /**< Seed of the Poisson gaps */
+
+    /* Results of the last load_run() */
+    uint64_t *latencies_us; /**< From the intended send time until the response or failure */
+    uint64_t *service_us;   /**< From the actual send time until the response or failure */
+    size_t measured;        /**< Latency samples, one per sent request */
+    size_t completed;       /**< Requests answered with a response */
+    size_t failed;          /**< Requests that failed or timed out */
+    size_t sent;            /**< Requests sent */
+    size_t bodies;          /**< Distinct bodies, replayed round robin if fewer than sent */
+    uint64_t elapsed_us;    /**< Duration of the run */
+    uint64_t max_lag_us;    /**< Largest delay between intended and actual send */
+} load_t;
+
+/**
+ * @brief Connects the generator to the server
+ *
+ * @param load Pointer to the generator to initialize
+ * @param endpoint The server to connect to
+ * @param path The path requests are POSTed to
+ * @param content_type The Content-Type of the bodies
+ * @param connections Number of connections, at most LOAD_MAX_CONNECTIONS
+ * @param rate Requests per second
+ * @param arrival Whether requests arrive at a fixed or Poisson rate
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int load_init(load_t *load, const endpoint_t *endpoint, const char *path,
+              const char *content_type, size_t connections, double rate, load_arrival_t arrival);
+
+/**
+ * @brief Sends requests on schedule until all have completed
+ *
+ * The bodies are sent round robin and are borrowed until the call returns.
+ *
+ * @param load Pointer to the generator
+ * @param bodies The request bodies
+ * @param lengths The length of each body
+ * @param num_bodies Number of bodies
+ * @param total Number of requests to send
+ *
+ * @return Returns the number of requests answered, -1 on failure
+ */
+int load_run(load_t *load, char *bodies[], const size_t lengths[], size_t num_bodies,
+             size_t total);
+
+/**
+ * @brief Returns a latency percentile (nearest rank)
+ *
+ * @param latencies_us The latencies of a run, sorted in place
+ * @param count Number of latencies
+ * @param percentile The percentile, between 0 and 100
+ *
+ * @return Returns the latency in microseconds, 0 if there are none
+ */
+uint64_t load_percentile(uint64_t *latencies_us, size_t count, double percentile);
+
+/**
+ * @brief Prints the throughput and corrected latency percentiles of the last run
+ *
+ * @param load Pointer to the generator
+ * @param out Where to print the report
+ */
+void load_report(load_t *load, FILE *out);
+
+/**
+ * @brief Closes the connections and frees the results
+ *
+ * @param load Pointer to the generator
+ */
+void load_destroy(load_t *load);
+
+#endif
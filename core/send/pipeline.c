@@ -0,0 +1,137 @@
+#include "pipeline.h"
+#include "uring.h"
+#include "engine.h"
+#include "../utils/buffer.h"
+
+// Receive buffer, kept per thread and grown to the largest batch seen
+static __thread char *recv_buffer = NULL;
+static __thread size_t recv_capacity = 0;
+
+int http_POST_pipelined(int sock, const post_template_t *tpl,
+                        pipeline_request_t reqs[], size_t count, size_t window,
+                        long timeout_ms)
+{
+    if (sock < 0 || tpl == NULL || reqs == NULL || window == 0 || window > PIPELINE_MAX_WINDOW)
+        return -1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        reqs[i].status = 0;
+        reqs[i].result = -1;
+    }
+
+    // Responses may arrive back to back, leftovers stay at the start of the buffer
+    if (buffer_reserve(&recv_buffer, &recv_capacity, BUFFER_SIZE * 2) != 0)
+        return -1;
+    char *buffer = recv_buffer;
+    size_t buffered = 0;
+    buffer[0] = '\0';
+    http_parser_t parser;
+    // Deadline of each request in flight, slot i % window
+    uint64_t deadlines[PIPELINE_MAX_WINDOW];
+
+    size_t sent = 0;
+    size_t done = 0;
+    int alive = 1;
+    while (done < count && alive)
+    {
+        // Fill the window
+        while (sent < count && sent - done < window)
+        {
+            if (http_send_POST(sock, tpl, reqs[sent].body, reqs[sent].body_len, 0, NULL) < 0)
+            {
+                alive = 0;
+                break;
+            }
+            deadlines[sent % window] = timeout_ms > 0 ? engine_now_ms() + timeout_ms : 0;
+            sent++;
+        }
+        if (!alive)
+            break;
+
+        // Read until the oldest in-flight response is complete, resuming the parse per packet
+        http_parser_init(&parser);
+        int parsed;
+        while ((parsed = http_parser_feed(&parser, buffer, buffered)) == HTTP_PARSE_MORE)
+        {
+            if (buffered >= recv_capacity - 1)
+            {
+                if (buffer_reserve(&recv_buffer, &recv_capacity, recv_capacity * 2) != 0)
+                {
+                    parsed = HTTP_PARSE_ERROR;
+                    break;
+                }
+                buffer = recv_buffer;
+            }
+            // A stalled response fails this and every later request
+            if (http_wait_readable(sock, deadlines[done % window]) <= 0)
+            {
+                parsed = HTTP_PARSE_ERROR;
+                break;
+            }
+            ssize_t received = recv(sock, buffer + buffered, recv_capacity - 1 - buffered, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+            {
+                parsed = HTTP_PARSE_ERROR;
+                break;
+            }
+            buffered += received;
+        }
+        if (parsed != HTTP_PARSE_DONE)
+        {
+            alive = 0;
+            break;
+        }
+
+        size_t frame_len = parser.offset;
+        pipeline_request_t *req = &reqs[done++];
+        req->status = parser.status;
+        req->result = 0;
+        if (req->response != NULL)
+        {
+            if (frame_len < req->response_size)
+            {
+                memcpy(req->response, buffer, frame_len);
+                req->response[frame_len] = '\0';
+            }
+            else
+            {
+                req->result = -1;
+            }
+        }
+        // Requests behind a "Connection: close" will never be answered
+        alive = parser.keep_alive;
+
+        memmove(buffer, buffer + frame_len, buffered - frame_len);
+        buffered -= frame_len;
+        buffer[buffered] = '\0';
+    }
+    return alive;
+}
+
+int pool_POST_pipelined(conn_pool_t *pool, pipeline_request_t reqs[],
+                        size_t count, size_t window)
+{
+    conn_t *conn = pool_checkout(pool);
+    if (conn == NULL)
+        return -1;
+
+    int alive;
+    if (pool->uring != NULL)
+        alive = uring_POST_pipelined(pool->uring, conn->socket, &pool->post, reqs, count, window,
+                                     pool->timeout_ms);
+    else
+        alive = http_POST_pipelined(conn->socket, &pool->post, reqs, count, window,
+                                    pool->timeout_ms);
+    pool_checkin(pool, conn, alive == 1);
+
+    int answered = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (reqs[i].result == 0)
+            answered++;
+    }
+    return answered;
+}
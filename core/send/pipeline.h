@@ -0,0 +1,76 @@
+/**
+ * @file pipeline.h
+ * @brief HTTP/1.1 request pipelining on a single connection
+ *
+ * Keeps up to a window of POST requests in flight on one connection instead
+ * of waiting a full round trip for every response. Responses are matched to
+ * requests in FIFO order, as HTTP/1.1 requires.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "send.h"
+#include "pool.h"
+
+#define PIPELINE_DEFAULT_WINDOW 1
+#define PIPELINE_MAX_WINDOW 64
+
+/**
+ * @brief One request in a pipelined exchange
+ *
+ * The caller fills in the body and, optionally, a response buffer. The
+ * pipeline fills in the status and result.
+ */
+typedef struct pipeline_request
+{
+    const char *body;     /**< Body to send, borrowed until the exchange returns */
+    size_t body_len;      /**< Length of the body */
+    char *response;       /**< Optional buffer for the full response, may be NULL */
+    size_t response_size; /**< Size of the response buffer */
+    int status;           /**< HTTP status code, 0 if no response arrived */
+    int result;           /**< 0 if a response arrived, -1 if the request failed */
+} pipeline_request_t;
+
+/**
+ * @brief Sends POST requests pipelined on one connection
+ *
+ * Up to window requests are in flight at a time. A request fails on its own
+ * if its response is malformed or does not fit in its response buffer. If the
+ * connection breaks, the server closes it or a response misses its deadline,
+ * every request without a response is marked as failed.
+ *
+ * @param sock The socket descriptor for the connection to the server
+ * @param tpl The pre-rendered POST header
+ * @param reqs The requests to send, in order
+ * @param count Number of requests
+ * @param window Maximum number of requests in flight, at most PIPELINE_MAX_WINDOW
+ * @param timeout_ms Time allowed for each response from when its request was
+ *        sent, 0 for none
+ *
+ * @return Returns 1 if the connection can be reused, 0 if it must be closed,
+ *         -1 on invalid arguments or if no receive buffer could be allocated
+ */
+int http_POST_pipelined(int sock, const post_template_t *tpl,
+                        pipeline_request_t reqs[], size_t count, size_t window,
+                        long timeout_ms);
+
+/**
+ * @brief Sends POST requests pipelined on a pooled connection
+ *
+ * Uses the pool's io_uring backend if one is attached, sockets otherwise.
+ * Each response is bounded by the pool's request timeout.
+ *
+ * @param pool Pointer to the pool
+ * @param reqs The requests to send, in order
+ * @param count Number of requests
+ * @param window Maximum number of requests in flight
+ *
+ * @return Returns the number of requests that got a response, -1 if no
+ *         connection could be checked out
+ */
+int pool_POST_pipelined(conn_pool_t *pool, pipeline_request_t reqs[],
+                        size_t count, size_t window);
+
+#endif
@@ -0,0 +1,361 @@
+#include "pool.h"
+#include "uring.h"
+
+#include <time.h>
+
+// Seed for the backoff jitter, one per thread
+static __thread unsigned int jitter_seed = 0;
+
+// Random wait between 0 and max_ms
+static long pool_jitter_ms(long max_ms)
+{
+    if (jitter_seed == 0)
+        jitter_seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&jitter_seed;
+    if (max_ms <= 0)
+        return 0;
+    return rand_r(&jitter_seed) % (max_ms + 1);
+}
+
+// Find the first connection in the given state
+static conn_t *pool_find(conn_pool_t *pool, conn_state_t state)
+{
+    for (size_t i = 0; i < pool->size; i++)
+    {
+        if (pool->conns[i].state == state)
+            return &pool->conns[i];
+    }
+    return NULL;
+}
+
+static void pool_set_connected(conn_t *conn, int sock, conn_state_t state, int zerocopy)
+{
+    conn->socket = sock;
+    conn->state = state;
+    conn->requests = 0;
+    conn->zerocopy = zerocopy;
+}
+
+// Set up a freshly connected socket, enabling zerocopy sends if the pool wants them
+static int pool_configure(conn_pool_t *pool, int sock, int *zerocopy)
+{
+    *zerocopy = 0;
+    if (sock < 0)
+        return -1;
+    // A server that stops reading must not block a send forever
+    if (pool->timeout_ms > 0)
+        http_set_send_timeout(sock, pool->timeout_ms);
+    if (pool->zerocopy)
+        *zerocopy = http_enable_zerocopy(sock) == 0;
+    return sock;
+}
+
+// Open a new connection
+static int pool_connect(conn_pool_t *pool, int *zerocopy)
+{
+    return pool_configure(pool, connect_endpoint(&pool->endpoint, pool->connect_timeout_ms),
+                          zerocopy);
+}
+
+// Open count connections, with io_uring as one batch of connects
+static void pool_connect_many(conn_pool_t *pool, int socks[], int zerocopy[], size_t count)
+{
+    if (pool->uring != NULL && count > 1)
+    {
+        // Only sockets whose connect completed come back, the rest are -1
+        if (uring_connect(pool->uring, &pool->endpoint, socks, count, pool->connect_timeout_ms) >= 0)
+        {
+            for (size_t i = 0; i < count; i++)
+                socks[i] = pool_configure(pool, socks[i], &zerocopy[i]);
+            return;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+        socks[i] = pool_connect(pool, &zerocopy[i]);
+}
+
+static void *pool_reconnect_loop(void *arg)
+{
+    conn_pool_t *pool = (conn_pool_t *)arg;
+    long backoff_ms = POOL_RECONNECT_MIN_MS;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running)
+    {
+        // With io_uring every dead connection is reconnected in one batch, else one at a time.
+        // Reserve the slots so no request reconnects them at the same time
+        conn_t *dead[POOL_MAX_CONNECTIONS];
+        size_t count = 0;
+        for (size_t i = 0; i < pool->size && (count == 0 || pool->uring != NULL); i++)
+        {
+            if (pool->conns[i].state != CONN_DEAD)
+                continue;
+            dead[count] = &pool->conns[i];
+            dead[count++]->state = CONN_CONNECTING;
+        }
+        if (count == 0)
+        {
+            pthread_cond_wait(&pool->dead, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        int socks[POOL_MAX_CONNECTIONS];
+        int zerocopy[POOL_MAX_CONNECTIONS];
+        pool_connect_many(pool, socks, zerocopy, count);
+        pthread_mutex_lock(&pool->lock);
+
+        size_t connected = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (socks[i] < 0)
+            {
+                dead[i]->state = CONN_DEAD;
+                continue;
+            }
+            pool_set_connected(dead[i], socks[i], CONN_IDLE, zerocopy[i]);
+            pool->reconnects++;
+            connected++;
+            pthread_cond_signal(&pool->available);
+        }
+        if (connected == 0)
+        {
+            // Let waiting requests notice that the server is unreachable
+            pthread_cond_broadcast(&pool->available);
+            // Jitter the wait so restarted servers are not hit by every client at once
+            long wait_ms = backoff_ms / 2 + pool_jitter_ms(backoff_ms / 2);
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += wait_ms / 1000;
+            deadline.tv_nsec += (wait_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&pool->dead, &pool->lock, &deadline);
+            backoff_ms *= 2;
+            if (backoff_ms > POOL_RECONNECT_MAX_MS)
+                backoff_ms = POOL_RECONNECT_MAX_MS;
+            continue;
+        }
+        backoff_ms = POOL_RECONNECT_MIN_MS;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int pool_init(conn_pool_t *pool, const endpoint_t *endpoint, const char *path,
+              const char *content_type, size_t size)
+{
+    if (pool == NULL || endpoint == NULL || content_type == NULL || size == 0 ||
+        size > POOL_MAX_CONNECTIONS)
+    {
+        fprintf(stderr, "Invalid pool configuration\n");
+        return -1;
+    }
+    memset(pool, 0, sizeof(conn_pool_t));
+    pool->endpoint = *endpoint;
+    pool->size = size;
+    pool->connect_timeout_ms = CONNECT_TIMEOUT_MS;
+    pool->timeout_ms = REQUEST_TIMEOUT_MS;
+    pool->retry.attempts = POOL_RETRY_ATTEMPTS;
+    pool->retry.base_ms = POOL_RETRY_BASE_MS;
+    pool->retry.max_ms = POOL_RETRY_MAX_MS;
+    pool->zerocopy = POOL_ZEROCOPY;
+    pool->content_type = content_type;
+    if (post_template_init(&pool->post, path, pool->endpoint.host, content_type) != 0)
+    {
+        fprintf(stderr, "Could not render POST header\n");
+        return -1;
+    }
+
+    size_t connected = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        int zerocopy;
+        int sock = pool_connect(pool, &zerocopy);
+        if (sock < 0)
+        {
+            pool_set_connected(&pool->conns[i], -1, CONN_DEAD, 0);
+            continue;
+        }
+        pool_set_connected(&pool->conns[i], sock, CONN_IDLE, zerocopy);
+        connected++;
+    }
+    if (connected == 0)
+    {
+        fprintf(stderr, "Could not open any pooled connection\n");
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    pthread_cond_init(&pool->dead, NULL);
+    pool->running = 1;
+    if (pthread_create(&pool->reconnector, NULL, pool_reconnect_loop, pool) != 0)
+    {
+        fprintf(stderr, "Could not start reconnect thread\n");
+        pool->running = 0;
+        pool_destroy(pool);
+        return -1;
+    }
+    return 0;
+}
+
+conn_t *pool_checkout(conn_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running)
+    {
+        conn_t *conn = pool_find(pool, CONN_IDLE);
+        if (conn != NULL)
+        {
+            conn->state = CONN_BUSY;
+            pthread_mutex_unlock(&pool->lock);
+            return conn;
+        }
+        // Someone is going to return or reconnect a connection, wait for it
+        if (pool_find(pool, CONN_BUSY) != NULL || pool_find(pool, CONN_CONNECTING) != NULL)
+        {
+            pthread_cond_wait(&pool->available, &pool->lock);
+            continue;
+        }
+        // Every connection is dead, reconnect one instead of waiting for the backoff
+        conn = pool_find(pool, CONN_DEAD);
+        conn->state = CONN_CONNECTING;
+        pthread_mutex_unlock(&pool->lock);
+        int zerocopy;
+        int sock = pool_connect(pool, &zerocopy);
+        pthread_mutex_lock(&pool->lock);
+        if (sock < 0)
+        {
+            conn->state = CONN_DEAD;
+            pthread_cond_signal(&pool->dead);
+            break;
+        }
+        pool_set_connected(conn, sock, CONN_BUSY, zerocopy);
+        pool->reconnects++;
+        pthread_mutex_unlock(&pool->lock);
+        return conn;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+conn_t *pool_try_checkout(conn_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    conn_t *conn = pool->running ? pool_find(pool, CONN_IDLE) : NULL;
+    if (conn != NULL)
+        conn->state = CONN_BUSY;
+    pthread_mutex_unlock(&pool->lock);
+    return conn;
+}
+
+void pool_checkin(conn_pool_t *pool, conn_t *conn, int keep_alive)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (keep_alive)
+    {
+        conn->state = CONN_IDLE;
+        conn->requests++;
+        pthread_cond_signal(&pool->available);
+    }
+    else
+    {
+        close(conn->socket);
+        pool_set_connected(conn, -1, CONN_DEAD, 0);
+        pthread_cond_signal(&pool->dead);
+        // Waiters may now have to reconnect on their own
+        pthread_cond_broadcast(&pool->available);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_POST(conn_pool_t *pool, char *response, size_t response_size,
+              const char *path, const char *data, size_t data_len)
+{
+    // Requests to other paths render their own header
+    post_template_t other;
+    const post_template_t *tpl = &pool->post;
+    if (strcmp(path, pool->post.path) != 0)
+    {
+        if (post_template_init(&other, path, pool->endpoint.host, pool->content_type) != 0)
+            return -1;
+        tpl = &other;
+    }
+
+    int attempts = pool->retry.attempts > 0 ? pool->retry.attempts : 1;
+    int backoffs = 0;
+    for (int attempt = 0; attempt < attempts; attempt++)
+    {
+        conn_t *conn = pool_checkout(pool);
+        if (conn == NULL)
+            return -1;
+        int reused = conn->requests > 0;
+
+        int pending;
+        int sent = http_send_POST(conn->socket, tpl, data, data_len, conn->zerocopy, &pending);
+        http_parser_t parser;
+        int res = sent < 0 ? -1 : http_recv_response(conn->socket, response, response_size, &parser,
+                                                     pool->timeout_ms);
+        // The body is only ours again once the kernel has released it, even after a failed send
+        if (pending > 0 && http_zerocopy_wait(conn->socket, pending) != 0)
+            conn->zerocopy = 0;
+        if (res >= 0)
+        {
+            pool_checkin(pool, conn, parser.keep_alive);
+            return res;
+        }
+        // A late response would desync the connection, never reuse it
+        pool_checkin(pool, conn, 0);
+        if (!pool_retry_wait(pool, attempt, reused, &backoffs))
+            break;
+    }
+    return -1;
+}
+
+int pool_retry_wait(conn_pool_t *pool, int attempt, int reused, int *backoffs)
+{
+    int attempts = pool->retry.attempts > 0 ? pool->retry.attempts : 1;
+    if (attempt + 1 >= attempts)
+        return 0;
+    // The server most likely recycled a reused connection, so only the first retry skips the wait
+    if (attempt == 0 && reused)
+        return 1;
+    long wait_ms = retry_backoff_ms(&pool->retry, (*backoffs)++);
+    struct timespec ts = {.tv_sec = wait_ms / 1000, .tv_nsec = (wait_ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+    return 1;
+}
+
+long retry_backoff_ms(const retry_policy_t *policy, int attempt)
+{
+    long cap = policy->base_ms;
+    for (int i = 0; i < attempt && cap < policy->max_ms; i++)
+        cap *= 2;
+    if (cap > policy->max_ms)
+        cap = policy->max_ms;
+    return pool_jitter_ms(cap);
+}
+
+void pool_destroy(conn_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    int was_running = pool->running;
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->dead);
+    pthread_cond_broadcast(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+    if (was_running)
+        pthread_join(pool->reconnector, NULL);
+
+    for (size_t i = 0; i < pool->size; i++)
+    {
+        if (pool->conns[i].socket >= 0)
+            close(pool->conns[i].socket);
+        pool_set_connected(&pool->conns[i], -1, CONN_DEAD, 0);
+    }
+    pthread_cond_destroy(&pool->dead);
+    pthread_cond_destroy(&pool->available);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,192 @@
+/**
+ * @file pool.h
+ * @brief Pool of persistent HTTP/1.1 keep-alive connections to the server
+ *
+ * The pool keeps a fixed number of sockets open to the server. Requests check a
+ * connection out, use it and check it back in. Connections the server closes
+ * (EOF or "Connection: close") are marked dead and reconnected by a background
+ * thread, so a recycled connection never stops the client. With an io_uring
+ * backend, all dead connections are reconnected with one batch of connects.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+#include "send.h"
+
+#define POOL_MAX_CONNECTIONS 16
+#define POOL_DEFAULT_SIZE 2
+#define POOL_RECONNECT_MIN_MS 50
+#define POOL_RECONNECT_MAX_MS 5000
+#define POOL_ZEROCOPY 1
+#define POOL_RETRY_ATTEMPTS 3
+#define POOL_RETRY_BASE_MS 20
+#define POOL_RETRY_MAX_MS 1000
+
+struct uring;
+
+/**
+ * @brief State of a pooled connection
+ */
+typedef enum conn_state
+{
+    CONN_DEAD,       /**< Socket closed, waiting to be reconnected */
+    CONN_CONNECTING, /**< Being reconnected */
+    CONN_IDLE,       /**< Connected and ready to be checked out */
+    CONN_BUSY        /**< Checked out by a request */
+} conn_state_t;
+
+/**
+ * @brief How failed requests are retried
+ *
+ * Attempt n (from 0) waits a random time between 0 and
+ * min(max_ms, base_ms * 2^n) first ("full jitter"), so clients that failed
+ * together do not retry in lockstep. The first retry of a request that
+ * failed on a reused connection goes out right away, the server most likely
+ * recycled it. Every later retry backs off.
+ */
+typedef struct retry_policy
+{
+    int attempts; /**< Total attempts per request, at least 1 */
+    long base_ms; /**< Backoff before the first retry */
+    long max_ms;  /**< Upper bound of the backoff */
+} retry_policy_t;
+
+/**
+ * @brief A single pooled connection
+ */
+typedef struct conn
+{
+    int socket;         /**< Socket descriptor, -1 when dead */
+    conn_state_t state; /**< Current state of the connection */
+    size_t requests;    /**< Requests served on the current socket */
+    int zerocopy;       /**< MSG_ZEROCOPY is enabled and worth using */
+} conn_t;
+
+/**
+ * @brief Struct holding the pooled connections to one server
+ *
+ * All fields are protected by the lock. The reconnect thread sleeps on
+ * the dead condition and the requests sleep on the available condition.
+ */
+typedef struct conn_pool
+{
+    endpoint_t endpoint;
+    size_t size;
+    long connect_timeout_ms; /**< Deadline for connects, 0 for none */
+    long timeout_ms;         /**< Deadline for each request, 0 for none */
+    retry_policy_t retry;   /**< Retry policy of pool_POST() */
+    int zerocopy;         /**< Try MSG_ZEROCOPY on new connections */
+    post_template_t post; /**< Header for POST requests to the pool path */
+    const char *content_type; /**< Content-Type of the POST bodies */
+    struct uring *uring;  /**< io_uring backend for pipelined requests and batched reconnects, NULL for sockets */
+    conn_t conns[POOL_MAX_CONNECTIONS];
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    pthread_cond_t dead;
+    pthread_t reconnector;
+    int running;
+    size_t reconnects; /**< Number of successful reconnects */
+} conn_pool_t;
+
+/**
+ * @brief Opens the pooled connections and starts the reconnect thread
+ *
+ * At least one connection has to be established for the pool to start,
+ * the remaining ones are retried in the background. Connects are bounded by
+ * CONNECT_TIMEOUT_MS and requests by REQUEST_TIMEOUT_MS, both can be changed
+ * in the pool afterwards.
+ *
+ * @param pool Pointer to the pool to initialize
+ * @param endpoint The server to connect to, TCP or Unix domain socket
+ * @param path The path POST requests are usually sent to, its header is rendered once
+ * @param content_type The Content-Type of the bodies, must outlive the pool
+ * @param size Number of connections, at most POOL_MAX_CONNECTIONS
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int pool_init(conn_pool_t *pool, const endpoint_t *endpoint, const char *path,
+              const char *content_type, size_t size);
+
+/**
+ * @brief Checks out an idle connection from the pool
+ *
+ * Blocks until a connection is idle. If every connection is dead the
+ * caller reconnects one itself instead of waiting on the reconnect thread.
+ *
+ * @param pool Pointer to the pool
+ *
+ * @return Returns the connection, NULL if the server cannot be reached
+ */
+conn_t *pool_checkout(conn_pool_t *pool);
+
+/**
+ * @brief Checks out an idle connection without waiting
+ *
+ * @param pool Pointer to the pool
+ *
+ * @return Returns the connection, NULL if none is idle right now
+ */
+conn_t *pool_try_checkout(conn_pool_t *pool);
+
+/**
+ * @brief Returns a connection to the pool
+ *
+ * @param pool Pointer to the pool
+ * @param conn The connection from pool_checkout()
+ * @param keep_alive 1 if the connection can be reused, 0 to close it and
+ *                   hand it to the reconnect thread
+ */
+void pool_checkin(conn_pool_t *pool, conn_t *conn, int keep_alive);
+
+/**
+ * @brief Sends a POST request on a pooled connection
+ *
+ * The response has to arrive within the pool's timeout. Failed requests are
+ * retried on another connection according to the pool's retry policy.
+ *
+ * @param pool Pointer to the pool
+ * @param response A pointer to a buffer where the response will be stored
+ * @param response_size The size of the response buffer
+ * @param path The path to send the POST request to
+ * @param data The data to be sent in the POST request, sent in place
+ * @param data_len The length of the data
+ *
+ * @return Returns the number of bytes received, -1 on failure
+ */
+int pool_POST(conn_pool_t *pool, char *response, size_t response_size,
+              const char *path, const char *data, size_t data_len);
+
+/**
+ * @brief Decides whether a failed attempt is retried and waits for its backoff
+ *
+ * @param pool Pointer to the pool holding the retry policy
+ * @param attempt The number of the attempt that failed, from 0
+ * @param reused 1 if the attempt was sent on a connection that had served requests before
+ * @param backoffs Number of backoffs waited so far for this request, counted up
+ *
+ * @return Returns 1 if the request should be sent again, 0 if no attempts are left
+ */
+int pool_retry_wait(conn_pool_t *pool, int attempt, int reused, int *backoffs);
+
+/**
+ * @brief Picks a jittered backoff for a retry
+ *
+ * @param policy The retry policy
+ * @param attempt The number of the retry, from 0
+ *
+ * @return Returns the time to wait in milliseconds
+ */
+long retry_backoff_ms(const retry_policy_t *policy, int attempt);
+
+/**
+ * @brief Stops the reconnect thread and closes all connections
+ *
+ * @param pool Pointer to the pool
+ */
+void pool_destroy(conn_pool_t *pool);
+
+#endif
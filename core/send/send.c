@@ -1,63 +1,402 @@
 
 #include "send.h"
+#include "engine.h"
 
-int connect_to_server(char *server_ip, int server_port)
+// Event loop behind the synchronous GET/POST calls, created on first use per thread
+static __thread engine_t sync_engine;
+static __thread int sync_engine_ready = 0;
+
+// Run one request on an already connected socket and wait for its response
+static int http_exchange(int sock, engine_request_t *ereq, const post_template_t *tpl,
+                         const char *body, size_t body_len, const char *path,
+                         const char *host, char *response, size_t response_size)
+{
+    if (!sync_engine_ready)
+    {
+        if (engine_init(&sync_engine, 1) != 0)
+            return -1;
+        sync_engine_ready = 1;
+    }
+    engine_conn_t *conn = engine_adopt(&sync_engine, sock);
+    if (conn == NULL)
+        return -1;
+    int res;
+    if (tpl != NULL)
+        res = engine_submit_POST(conn, ereq, tpl, body, body_len, response, response_size,
+                                 REQUEST_TIMEOUT_MS, NULL, NULL);
+    else
+        res = engine_submit_GET(conn, ereq, path, host, response, response_size,
+                                REQUEST_TIMEOUT_MS, NULL, NULL);
+    if (res == 0)
+        res = engine_wait(&sync_engine, ereq);
+    engine_release(conn);
+    if (res != ENGINE_OK)
+        return -1;
+    return ereq->response_len;
+}
+
+int endpoint_parse(endpoint_t *ep, const char *spec, int default_port)
 {
-    struct sockaddr_in server_addr;
+    if (ep == NULL || spec == NULL)
+        return -1;
+    memset(ep, 0, sizeof(endpoint_t));
+    size_t prefix_len = strlen(ENDPOINT_UNIX_PREFIX);
+    if (strncmp(spec, ENDPOINT_UNIX_PREFIX, prefix_len) == 0)
+    {
+        const char *path = spec + prefix_len;
+        if (*path == '\0' || strlen(path) >= sizeof(ep->path))
+        {
+            fprintf(stderr, "Invalid socket path %s\n", path);
+            return -1;
+        }
+        ep->family = AF_UNIX;
+        bad_strncpy(ep->path, path, sizeof(ep->path));
+        bad_strncpy(ep->host, ENDPOINT_UNIX_HOST, sizeof(ep->host));
+        return 0;
+    }
+    ep->family = AF_INET;
+    ep->port = default_port;
+    const char *colon = strchr(spec, ':');
+    size_t host_len = colon != NULL ? (size_t)(colon - spec) : strlen(spec);
+    if (host_len == 0 || host_len >= sizeof(ep->host))
+    {
+        fprintf(stderr, "Invalid address %s\n", spec);
+        return -1;
+    }
+    memcpy(ep->host, spec, host_len);
+    ep->host[host_len] = '\0';
+    if (colon != NULL)
+    {
+        char *end;
+        long port = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0' || port <= 0 || port > 65535)
+        {
+            fprintf(stderr, "Invalid port in %s\n", spec);
+            return -1;
+        }
+        ep->port = (int)port;
+    }
+    return 0;
+}
+
+int endpoint_sockaddr(const endpoint_t *ep, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    if (ep->family == AF_UNIX)
+    {
+        struct sockaddr_un *un = (struct sockaddr_un *)addr;
+        un->sun_family = AF_UNIX;
+        bad_strncpy(un->sun_path, ep->path, sizeof(un->sun_path));
+        *addr_len = sizeof(struct sockaddr_un);
+        return 0;
+    }
+    struct sockaddr_in *in = (struct sockaddr_in *)addr;
+    in->sin_family = AF_INET;
+    in->sin_port = htons(ep->port);
+    if (inet_pton(AF_INET, ep->host, &in->sin_addr) <= 0)
+    {
+        fprintf(stderr, "Invalid address %s\n", ep->host);
+        return -1;
+    }
+    *addr_len = sizeof(struct sockaddr_in);
+    return 0;
+}
+
+int connect_endpoint(const endpoint_t *ep, long timeout_ms)
+{
+    struct sockaddr_storage server_addr;
+    socklen_t addr_len;
+    if (endpoint_sockaddr(ep, &server_addr, &addr_len) != 0)
+        return -1;
     int sock;
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    if ((sock = socket(ep->family, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
     {
         perror("sock creation failed");
         return -1;
     }
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(server_port);
-    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0)
+    if (connect(sock, (struct sockaddr *)&server_addr, addr_len) < 0)
     {
-        perror("Invalid address");
-        return -1;
+        if (errno != EINPROGRESS)
+        {
+            perror("Connection failed");
+            close(sock);
+            return -1;
+        }
+        // Wait for the handshake, the socket becomes writable once it is done
+        uint64_t deadline = timeout_ms > 0 ? engine_now_ms() + timeout_ms : 0;
+        struct pollfd pfd = {.fd = sock, .events = POLLOUT, .revents = 0};
+        int ready;
+        do
+        {
+            int wait_ms = -1;
+            if (deadline != 0)
+            {
+                uint64_t now = engine_now_ms();
+                wait_ms = now >= deadline ? 0 : (int)(deadline - now);
+            }
+            ready = poll(&pfd, 1, wait_ms);
+        } while (ready < 0 && errno == EINTR);
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (ready == 0)
+            err = ETIMEDOUT;
+        else if (ready < 0 || getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+            err = errno;
+        if (err != 0)
+        {
+            errno = err;
+            perror("Connection failed");
+            close(sock);
+            return -1;
+        }
     }
-    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    // Requests on the socket block, bounded by their own deadlines
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(sock, F_SETFL, flags & ~O_NONBLOCK) < 0)
     {
-        perror("Connection failed");
+        close(sock);
         return -1;
     }
     return sock;
 }
 
-int parse_http_body(char *body, const char *response)
+int http_set_send_timeout(int sock, long timeout_ms)
 {
-    if (response == NULL)
-    {
-        perror("Invalid response\n");
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
         return -1;
+    return 0;
+}
+
+int http_wait_readable(int sock, uint64_t deadline_ms)
+{
+    // Without a deadline the blocking receive does the waiting
+    if (deadline_ms == 0)
+        return 1;
+    struct pollfd pfd = {.fd = sock, .events = POLLIN, .revents = 0};
+    for (;;)
+    {
+        int wait_ms = -1;
+        if (deadline_ms != 0)
+        {
+            uint64_t now = engine_now_ms();
+            wait_ms = now >= deadline_ms ? 0 : (int)(deadline_ms - now);
+        }
+        int ready = poll(&pfd, 1, wait_ms);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready == 0)
+            errno = ETIMEDOUT;
+        return ready > 0 ? 1 : ready;
     }
-    // Find the start of the body
-    const char *body_start = NULL;
-    for (const char *ptr = response; *ptr != '\0'; ptr++)
+}
+
+int connect_to_server(char *server_ip, int server_port)
+{
+    endpoint_t ep;
+    memset(&ep, 0, sizeof(ep));
+    ep.family = AF_INET;
+    ep.port = server_port;
+    bad_strncpy(ep.host, server_ip, sizeof(ep.host));
+    return connect_endpoint(&ep, CONNECT_TIMEOUT_MS);
+}
+
+int http_recv_response(int sock, char *response, size_t response_size, http_parser_t *parser,
+                       long timeout_ms)
+{
+    http_parser_init(parser);
+    uint64_t deadline = timeout_ms > 0 ? engine_now_ms() + timeout_ms : 0;
+    size_t received = 0;
+    int parsed = HTTP_PARSE_MORE;
+    while (parsed == HTTP_PARSE_MORE)
     {
-        if (ptr[0] == '\r' && ptr[1] == '\n' && ptr[2] == '\r' && ptr[3] == '\n')
+        if (received >= response_size - 1)
+            return -1;
+        if (http_wait_readable(sock, deadline) <= 0)
+            return -1;
+        ssize_t n = recv(sock, response + received, response_size - 1 - received, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
         {
-            body_start = ptr + 4; // Skip "\r\n\r\n"
+            parsed = http_parser_eof(parser, response);
             break;
         }
+        received += n;
+        parsed = http_parser_feed(parser, response, received);
+    }
+    if (parsed != HTTP_PARSE_DONE)
+        return -1;
+    response[received] = '\0';
+    return received;
+}
+
+int post_template_init(post_template_t *tpl, const char *path, const char *host,
+                       const char *content_type)
+{
+    if (tpl == NULL || path == NULL || host == NULL || content_type == NULL)
+        return -1;
+    // The path is kept to tell requests to the pool path from others
+    if (strlen(path) >= sizeof(tpl->path))
+        return -1;
+
+    int len = snprintf(tpl->header, sizeof(tpl->header), "POST %s HTTP/1.1\r\n"
+                                                         "Host: %s\r\n"
+                                                         "Content-Type: %s\r\n"
+                                                         "Connection: keep-alive\r\n"
+                                                         "Content-Length: ",
+                       path, host, content_type);
+    if (len < 0 || (size_t)len >= sizeof(tpl->header))
+        return -1;
+    tpl->header_len = len;
+    bad_strncpy(tpl->path, path, sizeof(tpl->path));
+    return 0;
+}
+
+int http_enable_zerocopy(int sock)
+{
+    int one = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+        return -1;
+    return 0;
+}
+
+int http_send_POST(int sock, const post_template_t *tpl, const char *body,
+                   size_t body_len, int zerocopy, int *pending)
+{
+    if (pending != NULL)
+        *pending = 0;
+    // Only the Content-Length value and the header terminator change per request
+    char length_line[32];
+    int length_len = snprintf(length_line, sizeof(length_line), "%zu\r\n\r\n", body_len);
+    if (length_len < 0)
+        return -1;
+
+    struct iovec iov[3];
+    iov[0].iov_base = (void *)tpl->header;
+    iov[0].iov_len = tpl->header_len;
+    iov[1].iov_base = length_line;
+    iov[1].iov_len = length_len;
+    iov[2].iov_base = (void *)body;
+    iov[2].iov_len = body_len;
+
+    int flags = MSG_NOSIGNAL;
+    if (zerocopy && pending != NULL && body_len >= ZEROCOPY_THRESHOLD)
+        flags |= MSG_ZEROCOPY;
+
+    // Hand header and body to the kernel together, resuming after partial sends
+    struct iovec *cur = iov;
+    int iovcnt = 3;
+    while (iovcnt > 0)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = cur;
+        msg.msg_iovlen = iovcnt;
+        ssize_t sent = sendmsg(sock, &msg, flags);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // Out of pinned pages, fall back to a regular copying send
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY))
+            {
+                flags &= ~MSG_ZEROCOPY;
+                continue;
+            }
+            // Earlier zerocopy sends stay counted, their pages are still in use
+            return -1;
+        }
+        if (flags & MSG_ZEROCOPY)
+            (*pending)++;
+        while (iovcnt > 0 && (size_t)sent >= cur->iov_len)
+        {
+            sent -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            cur->iov_base = (char *)cur->iov_base + sent;
+            cur->iov_len -= sent;
+        }
+    }
+    return 0;
+}
+
+int http_zerocopy_wait(int sock, int pending)
+{
+    int copied = 0;
+    while (pending > 0)
+    {
+        // Completions are queued on the error queue, which poll reports as POLLERR
+        struct pollfd pfd = {.fd = sock, .events = 0, .revents = 0};
+        int ready = poll(&pfd, 1, ZEROCOPY_WAIT_MS);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return -1;
+
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock, &msg, MSG_ERRQUEUE) < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            return -1;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            struct sock_extended_err *serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // ee_info..ee_data is the range of completed zerocopy sends
+            pending -= serr->ee_data - serr->ee_info + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                copied = 1;
+        }
     }
+    return copied;
+}
 
-    if (body_start == NULL)
+int parse_http_body(char *body, char *response)
+{
+    if (response == NULL)
+    {
+        perror("Invalid response\n");
+        return -1;
+    }
+    // Parsed in place, chunked bodies are decoded over the response
+    http_parser_t parser;
+    http_parser_init(&parser);
+    size_t len = strlen(response);
+    int parsed = http_parser_feed(&parser, response, len);
+    if (parsed == HTTP_PARSE_MORE)
+        parsed = http_parser_eof(&parser, response);
+    if (parsed != HTTP_PARSE_DONE)
     {
         perror("Invalid response format\n");
         return -1;
     }
-    // Copy the responsebody to the provided buffer
-    size_t body_length = strlen(body_start) - 1;
-    if (body_length >= BUFFER_SIZE)
+    // Copy the response body to the provided buffer
+    if (parser.body.len >= BUFFER_SIZE)
     {
         perror("Response body too large\n");
         return -1;
     }
-    memcpy(body, body_start, body_length + 1);
-    body[body_length] = '\0'; // Null-terminate the string
+    // The server terminates the body with a newline
+    size_t body_length = parser.body.len;
+    if (body_length > 0 && parser.body.ptr[body_length - 1] == '\n')
+        body_length--;
+    memmove(body, parser.body.ptr, body_length);
+    body[body_length] = '\0';
     return 0;
 }
 
@@ -78,92 +417,28 @@ int create_GET_request(request_t *req, int sockfd, char *path, char *host)
     req->method[2] = 'T';
     req->method[3] = '\0';
     // path
+    if (strlen(path) >= sizeof(req->path))
+    {
+        fprintf(stderr, "Path %s is too long\n", path);
+        return -1;
+    }
     bad_strcpy(req->path, path);
     // host
     bad_strcpy(req->host, host);
     return 0;
 }
-int format_GET_request(char *formated_req, request_t *req)
-{
-    if (req == NULL)
-        return -1;
-
-    // Format the GET request
-    int len;
-    if ((len = snprintf(formated_req, BUFFER_SIZE, "%s %s HTTP/1.1\r\n"
-                                                   "Host: %s\r\n"
-                                                   "\r\n",
-                        req->method, req->path, req->host)) < 0)
-        return -1;
-    return len;
-}
-int http_GET(char *response, request_t *req, size_t response_size)
+int http_GET(char *response, request_t *req, size_t response_size, http_parser_t *parser)
 {
-    if (req->socket < 0)
+    if (req->socket < 0 || !response || response_size == 0)
         return -1;
 
-    static char request[BUFFER_SIZE];
-
-    int req_len = format_GET_request(request, req);
-    if (req_len < 0)
-        return -1;
-    // Send request in a single operation
-    if (send(req->socket, request, req_len, 0) < 0)
-    {
-        printf("Send failed\n");
-        return -1;
-    }
-
-    // Receive response in a single read if possible
-    ssize_t bytes_received = recv(req->socket, response, response_size - 1, 0);
-    if (bytes_received < 0)
-    {
-        perror("recv failed");
-        return -1;
-    }
-    if (bytes_received <= 0)
-        return -1;
-
-    response[bytes_received] = '\0';
-
-    const char *body_start = strstr(response, "\r\n\r\n");
-    if (!body_start)
-        return bytes_received;
-
-    // Check for Content-Length to see if we need more data
-    const char *cl_header = strstr(response, "Content-Length:");
-    if (!cl_header)
-        return bytes_received;
-
-    // Parse content length
-    int content_length = bad_atoi(cl_header + 16);
-    size_t header_size = (body_start + 4) - response;
-    size_t body_received = bytes_received - header_size;
-
-    // If we already have the complete response, return
-    if (body_received >= content_length)
-        return bytes_received;
-
-    // We need to read more data
-    size_t remaining = content_length - body_received;
-    if (remaining > response_size - bytes_received - 1)
-    {
-        remaining = response_size - bytes_received - 1;
-    }
-
-    // Read the exact remaining data in a single recv() call if possible
-    ssize_t additional = recv(req->socket,
-                              response + bytes_received,
-                              remaining,
-                              MSG_WAITALL);
-
-    if (additional > 0)
-    {
-        bytes_received += additional;
-    }
-
-    response[bytes_received] = '\0';
-    return bytes_received;
+    engine_request_t ereq;
+    int res = http_exchange(req->socket, &ereq, NULL, NULL, 0, req->path, req->host,
+                            response, response_size);
+    // The views of the parser point into response
+    if (res >= 0 && parser != NULL)
+        *parser = ereq.parser;
+    return res;
 }
 int test_connection()
 {
@@ -183,23 +458,19 @@ int test_connection()
     }
     // Send the ping GET request
     char response[BUFFER_SIZE];
-    int res = http_GET(response, &req, sizeof(response));
+    http_parser_t parser;
+    int res = http_GET(response, &req, sizeof(response), &parser);
     if (res < 0)
     {
         perror("Failed to send GET request\n");
         close(sock);
         return -1;
     }
-    // Look after "Pong"
-    char response_body[BUFFER_SIZE];
-    if (parse_http_body(response_body, response) < 0)
-    {
-        perror("Failed to parse response body\n");
-        close(sock);
-        return -1;
-    }
-
-    if (strcmp(response_body, "pong") != 0)
+    // Look after "pong" in the body, the server terminates it with a newline
+    size_t body_length = parser.body.len;
+    if (body_length > 0 && parser.body.ptr[body_length - 1] == '\n')
+        body_length--;
+    if (body_length != strlen("pong") || memcmp(parser.body.ptr, "pong", body_length) != 0)
     {
         perror("Failed to connect to server\n");
         close(sock);
@@ -228,46 +499,22 @@ int create_POST_request(request_t *req, int sockfd, char *path, char *host, cons
     req->method[3] = 'T';
     req->method[4] = '\0';
     // path
+    if (strlen(path) >= sizeof(req->path))
+    {
+        fprintf(stderr, "Path %s is too long\n", path);
+        return -1;
+    }
     bad_strcpy(req->path, path);
     // host
     bad_strcpy(req->host, host);
     // content type
-    bad_strncpy(req->content_type, "Content-Type: application/json", sizeof(req->content_type) + bad_strlen("Content-Type: application/json") + 1);
-    // contetn length
+    bad_strncpy(req->content_type, "application/json", sizeof(req->content_type));
+    // content length
     req->content_length = bad_strlen(data);
-    // data
-    if (req->content_length >= sizeof(req->data))
-    {
-        perror("Data too large\n");
-        return -1;
-    }
-    memcpy(req->data, data, req->content_length);
-    req->data[req->content_length] = '\0';
+    // data is borrowed from the caller and sent in place
+    req->data = data;
     return 0;
 }
-int format_POST_request(char *formated_req, request_t *req)
-{
-    if (req == NULL)
-        return -1;
-
-    // Format the POST request
-    int res = snprintf(formated_req, BUFFER_SIZE, "%s %s HTTP/1.1\r\n"
-                                                  "Host: %s\r\n"
-                                                  "Content-Type: %s\r\n"
-                                                  "Content-Length: %zu\r\n"
-                                                  "\r\n%s",
-                       req->method, req->path, SERVER_IP, req->content_type,
-                       req->content_length, req->data);
-
-    if (res < 0)
-        return -1;
-
-    // Check if truncation occurred (res >= BUFFER_SIZE)
-    if ((size_t)res >= BUFFER_SIZE)
-        return -1;
-
-    return res;
-}
 int setup_POST(char *request, int sock, request_t *req, const char *data, char *path, char *host)
 {
     if (req == NULL)
@@ -275,12 +522,9 @@ int setup_POST(char *request, int sock, request_t *req, const char *data, char *
         perror("Invalid request\n");
         return -1;
     }
-    // Create the request
+    // Create the request, the socket stays owned by the caller
     if (create_POST_request(req, sock, path, host, data) != 0)
-    {
-        close(sock);
         return -1;
-    }
 
     return 0;
 }
@@ -289,57 +533,12 @@ int http_POST(char *response, request_t *req, size_t response_size)
     if (!req || req->socket < 0 || !response || response_size == 0)
         return -1;
 
-    // Format the request
-    char request[BUFFER_SIZE];
-    int format_result = format_POST_request(request, req);
-    if (format_result < 0)
-        return -1;
-
-    // Send request in a single operation
-    if (send(req->socket, request, format_result, 0) < 0)
-        return -1;
-
-    // Receive initial response
-    ssize_t bytes_received = recv(req->socket, response, response_size - 1, 0);
-    if (bytes_received <= 0)
+    // Render the header, the body is sent straight from the caller's buffer
+    post_template_t tpl;
+    if (post_template_init(&tpl, req->path, req->host, req->content_type) != 0)
         return -1;
 
-    response[bytes_received] = '\0';
-
-    // Check for Content-Length to see if we need more data
-    const char *body_start = strstr(response, "\r\n\r\n");
-    if (!body_start)
-        return bytes_received;
-
-    const char *cl_header = strstr(response, "content-length:");
-    if (!cl_header)
-    {
-        return bytes_received;
-    }
-
-    // Parse content length
-    int content_length = bad_atoi(cl_header + 16);
-    size_t header_size = (body_start + 4) - response;
-    size_t body_received = bytes_received - header_size;
-
-    // If we already have the complete response, return
-    if (body_received >= (size_t)content_length)
-        return bytes_received;
-
-    // We need more data - calculate exactly how much
-    size_t remaining = content_length - body_received;
-    if (remaining > response_size - bytes_received - 1)
-        remaining = response_size - bytes_received - 1;
-
-    // Read the remaining data in a single operation
-    ssize_t additional = recv(req->socket,
-                              response + bytes_received,
-                              remaining,
-                              MSG_WAITALL);
-
-    if (additional > 0)
-        bytes_received += additional;
-
-    response[bytes_received] = '\0';
-    return bytes_received;
-}
\ No newline at end of file
+    engine_request_t ereq;
+    return http_exchange(req->socket, &ereq, &tpl, req->data, req->content_length,
+                         NULL, NULL, response, response_size);
+}
@@ -14,17 +14,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 
 #include "../utils/bad_string.h"
+#include "http_parser.h"
 
 #define BUFFER_SIZE 4096 * 2
 #define SERVER_PORT 12345
 #define SERVER_IP "129.242.236.85"
 #define LOCAL_SERVER_IP "127.0.0.1"
+#define HEADER_TEMPLATE_SIZE 256
+#define HTTP_PATH_SIZE 64
+#define ZEROCOPY_THRESHOLD 16384
+#define ZEROCOPY_WAIT_MS 1000
+#define ENDPOINT_UNIX_PREFIX "unix:"
+#define CONNECT_TIMEOUT_MS 3000
+#define REQUEST_TIMEOUT_MS 5000
+#define ENDPOINT_UNIX_HOST "localhost"
 
 /**
  * @brief Struct to hold request information
@@ -32,6 +50,9 @@
  * This struct contains the necessary information to send a request to the server.
  * It includes the host, port, method, path, headers, content type,
  * content length, and data to be sent.
+ *
+ * @note The data is borrowed from the caller and must stay valid until the
+ *       request has been sent.
  */
 typedef struct request
 {
@@ -39,12 +60,39 @@ typedef struct request
     char host[48];
     int port;
     char method[8];
-    char path[10];
+    char path[HTTP_PATH_SIZE];
     char content_type[32];
     size_t content_length;
-    char data[BUFFER_SIZE];
+    const char *data;
 } request_t;
 
+/**
+ * @brief Address of the server
+ *
+ * Either a TCP address or the path of a Unix domain stream socket for a
+ * server on the same host. HTTP is framed the same way on both.
+ */
+typedef struct endpoint
+{
+    int family;     /**< AF_INET or AF_UNIX */
+    char host[48];  /**< Server IP, or ENDPOINT_UNIX_HOST, sent as the Host header */
+    int port;       /**< Server port, unused for AF_UNIX */
+    char path[108]; /**< Socket path for AF_UNIX */
+} endpoint_t;
+
+/**
+ * @brief Pre-rendered POST header
+ *
+ * Holds the request line and every header up to and including
+ * "Content-Length: ". Only the length value is written per request.
+ */
+typedef struct post_template
+{
+    char header[HEADER_TEMPLATE_SIZE];
+    size_t header_len;
+    char path[HTTP_PATH_SIZE];
+} post_template_t;
+
 /**
  * @brief Finds the path in the URL
  *
@@ -60,14 +108,15 @@ int find_path(char *path, const char *url);
 /**
  * @brief Parses the HTTP body from the response
  *
- * This function parses the HTTP body from the given response.
+ * This function parses the HTTP body from the given response in place,
+ * chunked bodies are decoded over the response buffer.
  *
- * @param body A pointer to a buffer where the parsed body will be stored
+ * @param body A pointer to a buffer where the parsed body will be stored, may be the response
  * @param response The HTTP response string
  *
  * @return Returns 0 on success, -1 on failure
  */
-int parse_http_body(char *body, const char *response);
+int parse_http_body(char *body, char *response);
 
 /**
  * @brief Formats the HTTP header for the request
@@ -79,15 +128,151 @@ int parse_http_body(char *body, const char *response);
  */
 int format_http_request(char *request, request_t *req);
 
+/**
+ * @brief Parses a server endpoint
+ *
+ * Accepts "unix:/path/to.sock" for a Unix domain socket, "ip:port" or just
+ * "ip" for TCP.
+ *
+ * @param ep Pointer to the endpoint to fill
+ * @param spec The endpoint string
+ * @param default_port The port used if spec does not name one
+ *
+ * @return Returns 0 on success, -1 if spec is not a valid endpoint
+ */
+int endpoint_parse(endpoint_t *ep, const char *spec, int default_port);
+
+/**
+ * @brief Builds the socket address of an endpoint
+ *
+ * @param ep Pointer to the endpoint
+ * @param addr Filled with the socket address
+ * @param addr_len Set to the length of the address
+ *
+ * @return Returns 0 on success, -1 if the address is invalid
+ */
+int endpoint_sockaddr(const endpoint_t *ep, struct sockaddr_storage *addr, socklen_t *addr_len);
+
+/**
+ * @brief Connects to an endpoint within a deadline
+ *
+ * The connect is started non-blocking and abandoned if the handshake has not
+ * finished in time. The returned socket is blocking.
+ *
+ * @param ep Pointer to the endpoint
+ * @param timeout_ms Time allowed for the connect, 0 for none
+ *
+ * @return Returns socket on acomplishment, -1 on failure or timeout
+ */
+int connect_endpoint(const endpoint_t *ep, long timeout_ms);
+
+/**
+ * @brief Bounds how long a blocking send on a socket may stall
+ *
+ * @param sock The socket descriptor
+ * @param timeout_ms Maximum time a send may block, 0 for none
+ *
+ * @return Returns 0 on success, -1 on failure
+ */
+int http_set_send_timeout(int sock, long timeout_ms);
+
 /**
  * @brief Connects to the server using TCP/IP
  *
- * This function establishes a connection to the server using the specified host and port.
+ * This function establishes a connection to the server using the specified host and port,
+ * giving up after CONNECT_TIMEOUT_MS.
  *
  * @return Returns socket on acomplishment, -1 on failure
  */
 int connect_to_server(char *server_ip, int server_port);
 
+/**
+ * @brief Receives one HTTP response
+ *
+ * Reads until the parser has seen the whole response, which may span several
+ * packets, or the buffer is full. The response is NUL-terminated.
+ *
+ * @param sock The socket descriptor for the connection to the server
+ * @param response A pointer to a buffer where the response will be stored
+ * @param response_size The size of the response buffer
+ * @param parser Parser for the response, holds the status, keep-alive and a
+ *        view of the body on return
+ * @param timeout_ms Time allowed for the whole response, 0 for none
+ *
+ * @return Returns the number of bytes received, -1 on failure, EOF or
+ *         timeout (errno is ETIMEDOUT)
+ */
+int http_recv_response(int sock, char *response, size_t response_size, http_parser_t *parser,
+                       long timeout_ms);
+
+/**
+ * @brief Waits until a socket is readable or a deadline passes
+ *
+ * @param sock The socket descriptor
+ * @param deadline_ms Deadline from engine_now_ms(), 0 for none
+ *
+ * @return Returns 1 if readable, 0 on timeout (errno is ETIMEDOUT), -1 on failure
+ */
+int http_wait_readable(int sock, uint64_t deadline_ms);
+
+/**
+ * @brief Renders the constant part of a POST header once
+ *
+ * @param tpl A pointer to the template to fill
+ * @param path The path to send the POST request to, shorter than HTTP_PATH_SIZE
+ * @param host The server host
+ * @param content_type The value of the Content-Type header
+ *
+ * @return Returns 0 on success, -1 on failure or if the path does not fit
+ */
+int post_template_init(post_template_t *tpl, const char *path, const char *host,
+                       const char *content_type);
+
+/**
+ * @brief Enables MSG_ZEROCOPY sends on a socket
+ *
+ * @param sock The socket descriptor
+ *
+ * @return Returns 0 on success, -1 if the kernel does not support it
+ */
+int http_enable_zerocopy(int sock);
+
+/**
+ * @brief Sends a POST header and body with a single scatter-gather send
+ *
+ * The header is taken from the template with only Content-Length patched,
+ * and the body is sent from the caller's buffer without copying it into a
+ * request buffer. Bodies of at least ZEROCOPY_THRESHOLD bytes are sent with
+ * MSG_ZEROCOPY when requested.
+ *
+ * @param sock The socket descriptor for the connection to the server
+ * @param tpl The pre-rendered header
+ * @param body The body to send
+ * @param body_len The length of the body
+ * @param zerocopy 1 to use MSG_ZEROCOPY for large bodies (see http_enable_zerocopy())
+ * @param pending Set to the number of zerocopy sends to wait for, may be NULL
+ *                if zerocopy is 0
+ *
+ * @note If *pending is positive the body must not be modified until
+ *       http_zerocopy_wait() has returned, also when the send failed: the
+ *       kernel keeps the pages of the sends that went out pinned and may
+ *       still transmit them.
+ * @return Returns 0 on success, -1 on failure
+ */
+int http_send_POST(int sock, const post_template_t *tpl, const char *body,
+                   size_t body_len, int zerocopy, int *pending);
+
+/**
+ * @brief Waits until the kernel has released the buffers of zerocopy sends
+ *
+ * @param sock The socket descriptor the sends were made on
+ * @param pending The count reported by http_send_POST()
+ *
+ * @return Returns 1 if the kernel fell back to copying (zerocopy is not worth
+ *         it on this route), 0 if the data was sent in place, -1 on failure
+ */
+int http_zerocopy_wait(int sock, int pending);
+
 /**
  * @brief Sends a GET request to the specified path
  *
@@ -96,11 +281,12 @@ int connect_to_server(char *server_ip, int server_port);
  * @param response A pointer to a buffer where the response will be stored
  * @param req A pointer to the request_t struct containing request information
  * @param response_size The size of the response buffer
+ * @param parser Set to the parsed response, its views point into response. May be NULL
  *
  * @note The path is the last part of the URL, e.g., "/new" as the server is already defined
  * @return Returns 0 on success, -1 on failure
  */
-int http_GET(char *response, request_t *req, size_t response_size);
+int http_GET(char *response, request_t *req, size_t response_size, http_parser_t *parser);
 
 /**
  * @brief Creates a POST request
@@ -0,0 +1,723 @@
+#include "uring.h"
+#include "../utils/buffer.h"
+#include "engine.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+
+#define URING_RECV_TAG ((__u64)-1)
+#define URING_CANCEL_TAG ((__u64)-2)
+#define URING_CONNECT_TAG (1ULL << 62)
+#define URING_TIMEOUT_TAG ((__u64)-3)
+
+// Connect completions carry the batch number above the socket index
+#define URING_CONNECT_INDEX_MASK 0xFFFFULL
+#define URING_CONNECT_GEN_SHIFT 16
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Get a zeroed submission entry, NULL if the queue is full
+static struct io_uring_sqe *uring_get_sqe(uring_t *u)
+{
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *u->sq_tail + u->sq_pending;
+    if (tail - head > *u->sq_mask)
+        return NULL;
+    unsigned index = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[index] = index;
+    u->sq_pending++;
+    return sqe;
+}
+
+// Number of entries that can still be prepared
+static unsigned uring_sq_space(uring_t *u)
+{
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    return *u->sq_mask + 1 - (*u->sq_tail + u->sq_pending - head);
+}
+
+// Submit the prepared entries and wait for at least min_complete completions,
+// at most timeout_ms if the kernel can bound the wait (-1 with ETIME then)
+static int uring_submit(uring_t *u, unsigned min_complete, long timeout_ms)
+{
+    unsigned to_submit = u->sq_pending;
+    __atomic_store_n(u->sq_tail, *u->sq_tail + to_submit, __ATOMIC_RELEASE);
+    u->sq_pending = 0;
+
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg ext;
+    void *arg = NULL;
+    size_t argsz = 0;
+    if (min_complete > 0 && timeout_ms > 0 && u->ext_arg)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        memset(&ext, 0, sizeof(ext));
+        ext.ts = (__u64)(uintptr_t)&ts;
+        arg = &ext;
+        argsz = sizeof(ext);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    for (;;)
+    {
+        int res = uring_enter(u->fd, to_submit, min_complete, flags, arg, argsz);
+        if (res >= 0)
+            return res;
+        if (errno != EINTR)
+            return -1;
+        // Entries already consumed by the kernel are not submitted twice
+        to_submit = 0;
+    }
+}
+
+// Pop one completion, returns 0 if the queue is empty
+static int uring_pop_cqe(uring_t *u, struct io_uring_cqe *out)
+{
+    unsigned head = *u->cq_head;
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+        return 0;
+    *out = u->cqes[head & *u->cq_mask];
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Multishot receive came in 6.0, after provided buffer rings (5.19), and the
+// probe does not report opcode flags, so go by the kernel release
+static int uring_multishot_supported()
+{
+    struct utsname name;
+    int major = 0, minor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2)
+        return 0;
+    return major >= 6;
+}
+
+// Give a response buffer back to the kernel
+static void uring_provide_buffer(uring_t *u, unsigned short bid)
+{
+    struct io_uring_buf *buf = &u->buf_ring->bufs[u->buf_tail & (URING_RECV_BUFFERS - 1)];
+    buf->addr = (__u64)(uintptr_t)(u->recv_buffers + (size_t)bid * URING_RECV_BUFFER_SIZE);
+    buf->len = URING_RECV_BUFFER_SIZE;
+    buf->bid = bid;
+    u->buf_tail++;
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_setup_buffers(uring_t *u)
+{
+    u->buf_ring_size = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    u->buf_ring = (struct io_uring_buf_ring *)mmap(NULL, u->buf_ring_size, PROT_READ | PROT_WRITE,
+                                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->recv_buffers = (char *)mmap(NULL, URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE,
+                                   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->buf_ring == MAP_FAILED || u->recv_buffers == MAP_FAILED || !uring_multishot_supported())
+        return;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (__u64)(uintptr_t)u->buf_ring;
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = 0;
+    // Kernels before 5.19 cannot take a provided buffer ring
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return;
+    u->buf_tail = 0;
+    for (unsigned short bid = 0; bid < URING_RECV_BUFFERS; bid++)
+        uring_provide_buffer(u, bid);
+    u->multishot = 1;
+}
+
+// Reset a uring so that uring_destroy() can run at any point of the setup
+static void uring_clear(uring_t *u)
+{
+    memset(u, 0, sizeof(uring_t));
+    pthread_mutex_init(&u->lock, NULL);
+    u->fd = -1;
+    u->buf_ring = MAP_FAILED;
+    u->recv_buffers = MAP_FAILED;
+    u->arena = MAP_FAILED;
+    u->sq_ptr = u->cq_ptr = MAP_FAILED;
+    u->sqes = MAP_FAILED;
+}
+
+// Create the io_uring instance and map its rings
+static int uring_map(uring_t *u, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->fd = uring_setup(entries, &p);
+    if (u->fd < 0)
+        return -1;
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ext_arg = (p.features & IORING_FEAT_EXT_ARG) != 0;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (u->cq_size > u->sq_size)
+            u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED)
+        return -1;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        u->cq_ptr = u->sq_ptr;
+    else
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         u->fd, IORING_OFF_CQ_RING);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe *)mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->cq_ptr == MAP_FAILED || u->sqes == MAP_FAILED)
+        return -1;
+    u->sq_head = (unsigned *)((char *)u->sq_ptr + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ptr + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ptr + p.sq_off.array);
+    u->cq_head = (unsigned *)((char *)u->cq_ptr + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ptr + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ptr + p.cq_off.cqes);
+    return 0;
+}
+
+// Set up the ring for batched connects, reconnects fall back to sockets without it
+static void uring_setup_connects(uring_t *u)
+{
+    u->connects = (uring_t *)malloc(sizeof(uring_t));
+    if (u->connects == NULL)
+        return;
+    uring_clear(u->connects);
+    if (uring_map(u->connects, URING_CONNECT_ENTRIES) != 0)
+    {
+        uring_destroy(u->connects);
+        free(u->connects);
+        u->connects = NULL;
+    }
+}
+
+int uring_init(uring_t *u, size_t slots, size_t slot_size)
+{
+    if (u == NULL || slots == 0 || slot_size <= HEADER_TEMPLATE_SIZE)
+        return -1;
+    uring_clear(u);
+    if (uring_map(u, URING_ENTRIES) != 0)
+    {
+        uring_destroy(u);
+        return -1;
+    }
+
+    // Request arena, one registered buffer covering every slot
+    u->slots = slots;
+    u->slot_size = slot_size;
+    u->arena_size = slots * slot_size;
+    u->arena = (char *)mmap(NULL, u->arena_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->arena == MAP_FAILED)
+    {
+        uring_destroy(u);
+        return -1;
+    }
+    struct iovec arena_iov = {.iov_base = u->arena, .iov_len = u->arena_size};
+    u->registered = uring_register(u->fd, IORING_REGISTER_BUFFERS, &arena_iov, 1) == 0;
+
+    uring_setup_buffers(u);
+    uring_setup_connects(u);
+    return 0;
+}
+
+char *uring_body(uring_t *u, size_t slot, size_t *capacity)
+{
+    if (u == NULL || slot >= u->slots)
+        return NULL;
+    *capacity = u->slot_size - HEADER_TEMPLATE_SIZE;
+    return u->arena + slot * u->slot_size + HEADER_TEMPLATE_SIZE;
+}
+
+int uring_connect(uring_t *u, const endpoint_t *endpoint, int socks[], size_t count,
+                  long timeout_ms)
+{
+    uring_t *c = u->connects;
+    if (c == NULL || count > URING_CONNECT_ENTRIES / 2)
+        return -1;
+    for (size_t i = 0; i < count; i++)
+        socks[i] = -1;
+    struct sockaddr_storage server_addr;
+    socklen_t addr_len;
+    if (endpoint_sockaddr(endpoint, &server_addr, &addr_len) != 0)
+        return -1;
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    pthread_mutex_lock(&c->lock);
+    // Completions of an earlier batch that gave up carry an older batch number
+    c->connect_gen++;
+    __u64 tag = URING_CONNECT_TAG | ((__u64)c->connect_gen << URING_CONNECT_GEN_SHIFT);
+    int completed[URING_CONNECT_ENTRIES / 2];
+    size_t pending = 0;
+    unsigned needed = timeout_ms > 0 ? 2 : 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        completed[i] = 1;
+        // A connect without its linked timeout would have no deadline, fail it instead
+        if (uring_sq_space(c) < needed)
+            continue;
+        socks[i] = socket(endpoint->family, SOCK_STREAM, 0);
+        if (socks[i] < 0)
+            continue;
+        struct io_uring_sqe *sqe = uring_get_sqe(c);
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = socks[i];
+        sqe->addr = (__u64)(uintptr_t)&server_addr;
+        sqe->off = addr_len;
+        sqe->user_data = tag | i;
+        // The linked timeout cancels the connect if it misses the deadline
+        if (timeout_ms > 0)
+        {
+            struct io_uring_sqe *timeout = uring_get_sqe(c);
+            sqe->flags = IOSQE_IO_LINK;
+            timeout->opcode = IORING_OP_LINK_TIMEOUT;
+            timeout->addr = (__u64)(uintptr_t)&ts;
+            timeout->len = 1;
+            timeout->user_data = URING_TIMEOUT_TAG;
+        }
+        completed[i] = 0;
+        pending++;
+    }
+    if (pending > 0 && uring_submit(c, 0, 0) < 0)
+    {
+        // Nothing was consumed, take the entries back so they are never submitted later
+        __atomic_store_n(c->sq_tail, __atomic_load_n(c->sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        for (size_t i = 0; i < count; i++)
+            completed[i] = 1;
+        pending = 0;
+    }
+
+    int connected = 0;
+    while (pending > 0)
+    {
+        struct io_uring_cqe cqe;
+        if (!uring_pop_cqe(c, &cqe))
+        {
+            if (uring_submit(c, 1, 0) < 0)
+                break;
+            continue;
+        }
+        // Linked timeouts and connects of an abandoned batch are skipped
+        size_t i = cqe.user_data & URING_CONNECT_INDEX_MASK;
+        if ((cqe.user_data & ~URING_CONNECT_INDEX_MASK) != tag || i >= count || completed[i])
+            continue;
+        completed[i] = 1;
+        pending--;
+        if (cqe.res < 0)
+        {
+            close(socks[i]);
+            socks[i] = -1;
+            continue;
+        }
+        connected++;
+    }
+    if (pending > 0)
+    {
+        // The ring failed, cancel what is still in flight and give up on those sockets
+        for (size_t i = 0; i < count; i++)
+        {
+            struct io_uring_sqe *sqe = completed[i] ? NULL : uring_get_sqe(c);
+            if (sqe != NULL)
+            {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = tag | i;
+                sqe->user_data = URING_CANCEL_TAG;
+            }
+        }
+        uring_submit(c, 0, 0);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!completed[i] && socks[i] >= 0)
+        {
+            close(socks[i]);
+            socks[i] = -1;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return connected;
+}
+
+// Arm a receive on the socket, multishot into provided buffers when available
+static int uring_arm_recv(uring_t *u, int sock, char *fallback, size_t fallback_size)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (sqe == NULL)
+        return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sock;
+    sqe->user_data = URING_RECV_TAG;
+    if (u->multishot)
+    {
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    }
+    else
+    {
+        sqe->addr = (__u64)(uintptr_t)fallback;
+        sqe->len = fallback_size;
+    }
+    return 0;
+}
+
+int uring_POST_pipelined(uring_t *u, int sock, const post_template_t *tpl,
+                         pipeline_request_t reqs[], size_t count, size_t window,
+                         long timeout_ms)
+{
+    if (u == NULL || sock < 0 || tpl == NULL || reqs == NULL || window == 0 ||
+        window > PIPELINE_MAX_WINDOW)
+        return -1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        reqs[i].status = 0;
+        reqs[i].result = -1;
+    }
+
+    // Scratch for sends of bodies outside the arena, slot i % window is free again
+    // once request i has its response
+    struct msghdr msgs[PIPELINE_MAX_WINDOW];
+    struct iovec iovs[PIPELINE_MAX_WINDOW][3];
+    char length_lines[PIPELINE_MAX_WINDOW][32];
+    size_t send_len[PIPELINE_MAX_WINDOW];
+    uint64_t deadlines[PIPELINE_MAX_WINDOW];
+
+    char recv_fallback[URING_RECV_BUFFER_SIZE];
+
+    pthread_mutex_lock(&u->lock);
+    if (buffer_reserve(&u->responses, &u->responses_capacity, BUFFER_SIZE * 2) != 0)
+    {
+        pthread_mutex_unlock(&u->lock);
+        return -1;
+    }
+    char *buffer = u->responses;
+    size_t buffered = 0;
+    buffer[0] = '\0';
+    http_parser_t parser;
+    http_parser_init(&parser);
+    size_t sent = 0;
+    size_t done = 0;
+    int sends_inflight = 0;
+    int recv_armed = 0;
+    int chain_broken = 0;
+    int eof = 0;
+    int alive = 1;
+
+    while (done < count && alive)
+    {
+        // Queue the rest of the window as one linked chain so the sends stay in order.
+        // After a short send, wait until the cut off chain has drained before resending.
+        if (chain_broken && sends_inflight == 0)
+            chain_broken = 0;
+        struct io_uring_sqe *last = NULL;
+        while (!chain_broken && sent < count && sent - done < window)
+        {
+            struct io_uring_sqe *sqe = uring_get_sqe(u);
+            if (sqe == NULL)
+                break;
+            pipeline_request_t *req = &reqs[sent];
+            size_t slot = sent % window;
+            char *body = (char *)req->body;
+            int length_len = snprintf(length_lines[slot], sizeof(length_lines[slot]),
+                                      "%zu\r\n\r\n", req->body_len);
+            size_t header_len = tpl->header_len + length_len;
+
+            if (u->registered && body >= u->arena + header_len &&
+                body + req->body_len <= u->arena + u->arena_size &&
+                (size_t)(body - u->arena) % u->slot_size >= header_len)
+            {
+                // Body lives in the registered arena, put the header right in front of it
+                char *start = body - header_len;
+                memcpy(start, tpl->header, tpl->header_len);
+                memcpy(start + tpl->header_len, length_lines[slot], length_len);
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->fd = sock;
+                sqe->addr = (__u64)(uintptr_t)start;
+                sqe->len = header_len + req->body_len;
+                sqe->buf_index = 0;
+            }
+            else
+            {
+                iovs[slot][0].iov_base = (void *)tpl->header;
+                iovs[slot][0].iov_len = tpl->header_len;
+                iovs[slot][1].iov_base = length_lines[slot];
+                iovs[slot][1].iov_len = length_len;
+                iovs[slot][2].iov_base = body;
+                iovs[slot][2].iov_len = req->body_len;
+                memset(&msgs[slot], 0, sizeof(msgs[slot]));
+                msgs[slot].msg_iov = iovs[slot];
+                msgs[slot].msg_iovlen = 3;
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = sock;
+                sqe->addr = (__u64)(uintptr_t)&msgs[slot];
+                sqe->len = 1;
+                sqe->msg_flags = MSG_NOSIGNAL;
+            }
+            send_len[slot] = header_len + req->body_len;
+            deadlines[slot] = timeout_ms > 0 ? engine_now_ms() + timeout_ms : 0;
+            sqe->user_data = sent;
+            sqe->flags = IOSQE_IO_LINK;
+            last = sqe;
+            sent++;
+            sends_inflight++;
+        }
+        if (last != NULL)
+            last->flags &= ~IOSQE_IO_LINK;
+
+        if (!recv_armed && !eof)
+        {
+            if (uring_arm_recv(u, sock, recv_fallback, sizeof(recv_fallback)) == 0)
+                recv_armed = 1;
+        }
+        // One system call submits the window and waits for progress, at most
+        // until the oldest request in flight is due
+        long wait_ms = 0;
+        uint64_t deadline = done < sent ? deadlines[done % window] : 0;
+        if (deadline != 0)
+        {
+            uint64_t now = engine_now_ms();
+            wait_ms = now >= deadline ? 1 : (long)(deadline - now);
+        }
+        if (uring_submit(u, 1, wait_ms) < 0)
+        {
+            if (errno != ETIME)
+            {
+                alive = 0;
+                break;
+            }
+            if (engine_now_ms() >= deadline)
+            {
+                // Stalled server, shutting the socket down completes the pending sends and receive
+                shutdown(sock, SHUT_RDWR);
+                alive = 0;
+                break;
+            }
+        }
+
+        struct io_uring_cqe cqe;
+        while (uring_pop_cqe(u, &cqe))
+        {
+            if (cqe.user_data == URING_RECV_TAG)
+            {
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                    recv_armed = 0;
+                if (cqe.res == -ENOBUFS)
+                    continue;
+                if (cqe.res == -EINVAL && u->multishot)
+                {
+                    // The kernel rejects multishot receive, re-arm a plain one
+                    u->multishot = 0;
+                    continue;
+                }
+                if (cqe.res <= 0)
+                {
+                    eof = 1;
+                    continue;
+                }
+                const char *data = recv_fallback;
+                if (cqe.flags & IORING_CQE_F_BUFFER)
+                    data = u->recv_buffers + (size_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT) * URING_RECV_BUFFER_SIZE;
+                size_t len = cqe.res;
+                if (buffer_reserve(&u->responses, &u->responses_capacity, buffered + len + 1) != 0)
+                {
+                    alive = 0;
+                    len = 0;
+                }
+                buffer = u->responses;
+                memcpy(buffer + buffered, data, len);
+                buffered += len;
+                buffer[buffered] = '\0';
+                if (cqe.flags & IORING_CQE_F_BUFFER)
+                    uring_provide_buffer(u, cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                continue;
+            }
+            if (cqe.user_data >= count)
+                continue;
+
+            // Completion of a send
+            size_t index = cqe.user_data;
+            size_t slot = index % window;
+            sends_inflight--;
+            if (cqe.res == -ECANCELED && chain_broken)
+            {
+                // Cut off by a short send in front of it, send it again
+                if (index < sent)
+                    sent = index;
+                continue;
+            }
+            if (cqe.res < 0)
+            {
+                alive = 0;
+                continue;
+            }
+            if ((size_t)cqe.res < send_len[slot])
+            {
+                // Short send breaks the chain, finish this one synchronously
+                size_t offset = cqe.res;
+                const char *body = reqs[index].body;
+                size_t header_len = send_len[slot] - reqs[index].body_len;
+                while (offset < send_len[slot])
+                {
+                    ssize_t n;
+                    if (offset < header_len)
+                    {
+                        char header[HEADER_TEMPLATE_SIZE + 32];
+                        memcpy(header, tpl->header, tpl->header_len);
+                        memcpy(header + tpl->header_len, length_lines[slot], header_len - tpl->header_len);
+                        n = send(sock, header + offset, header_len - offset, MSG_NOSIGNAL);
+                    }
+                    else
+                    {
+                        n = send(sock, body + (offset - header_len), send_len[slot] - offset, MSG_NOSIGNAL);
+                    }
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                    {
+                        alive = 0;
+                        break;
+                    }
+                    offset += n;
+                }
+                chain_broken = 1;
+            }
+        }
+
+        // Hand out every complete response in FIFO order
+        int parsed;
+        while (done < sent && (parsed = http_parser_feed(&parser, buffer, buffered)) != HTTP_PARSE_MORE)
+        {
+            if (parsed == HTTP_PARSE_ERROR)
+            {
+                alive = 0;
+                break;
+            }
+            size_t frame_len = parser.offset;
+            pipeline_request_t *req = &reqs[done++];
+            req->status = parser.status;
+            req->result = 0;
+            if (req->response != NULL)
+            {
+                if (frame_len < req->response_size)
+                {
+                    memcpy(req->response, buffer, frame_len);
+                    req->response[frame_len] = '\0';
+                }
+                else
+                {
+                    req->result = -1;
+                }
+            }
+            if (!parser.keep_alive)
+                alive = 0;
+            memmove(buffer, buffer + frame_len, buffered - frame_len);
+            buffered -= frame_len;
+            buffer[buffered] = '\0';
+            http_parser_init(&parser);
+            if (!alive)
+                break;
+        }
+        if (eof && done < count)
+            alive = 0;
+    }
+
+    // The kernel must be done with the scratch and the bodies before returning
+    if (recv_armed)
+    {
+        struct io_uring_sqe *sqe = uring_get_sqe(u);
+        if (sqe != NULL)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = URING_RECV_TAG;
+            sqe->user_data = URING_CANCEL_TAG;
+        }
+    }
+    while (sends_inflight > 0 || recv_armed)
+    {
+        if (uring_submit(u, 1, 0) < 0)
+            break;
+        struct io_uring_cqe cqe;
+        while (uring_pop_cqe(u, &cqe))
+        {
+            if (cqe.user_data == URING_RECV_TAG)
+            {
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                    recv_armed = 0;
+                if (cqe.flags & IORING_CQE_F_BUFFER)
+                    uring_provide_buffer(u, cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                // Bytes arriving now belong to no request, the connection is out of sync
+                if (cqe.res > 0)
+                    alive = 0;
+            }
+            else if (cqe.user_data < count)
+            {
+                sends_inflight--;
+            }
+        }
+    }
+    pthread_mutex_unlock(&u->lock);
+    return alive;
+}
+
+void uring_destroy(uring_t *u)
+{
+    if (u->connects != NULL)
+    {
+        uring_destroy(u->connects);
+        free(u->connects);
+        u->connects = NULL;
+    }
+    if (u->buf_ring != MAP_FAILED && u->buf_ring != NULL)
+        munmap(u->buf_ring, u->buf_ring_size);
+    if (u->recv_buffers != MAP_FAILED && u->recv_buffers != NULL)
+        munmap(u->recv_buffers, URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE);
+    free(u->responses);
+    u->responses = NULL;
+    u->responses_capacity = 0;
+    if (u->arena != MAP_FAILED && u->arena != NULL)
+        munmap(u->arena, u->arena_size);
+    if (u->sqes != MAP_FAILED && u->sqes != NULL)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ptr != MAP_FAILED && u->cq_ptr != NULL && u->cq_ptr != u->sq_ptr)
+        munmap(u->cq_ptr, u->cq_size);
+    if (u->sq_ptr != MAP_FAILED && u->sq_ptr != NULL)
+        munmap(u->sq_ptr, u->sq_size);
+    if (u->fd >= 0)
+        close(u->fd);
+    u->fd = -1;
+    u->buf_ring = NULL;
+    u->recv_buffers = NULL;
+    u->arena = NULL;
+    u->sqes = NULL;
+    u->sq_ptr = u->cq_ptr = NULL;
+    pthread_mutex_destroy(&u->lock);
+}
@@ -0,0 +1,163 @@
+/**
+ * @file uring.h
+ * @brief io_uring transport backend for pipelined POST requests
+ *
+ * Submits connects, sends and receives as batches of io_uring submission
+ * queue entries so that a whole pipeline window costs a single system call.
+ * Request bodies serialized into the registered request arena are sent with
+ * IORING_OP_WRITE_FIXED, and responses arrive through a multishot receive
+ * into a ring of provided response buffers. Kernels before 6.0 have no
+ * multishot receive and get one plain receive at a time instead.
+ *
+ * The ring is set up with raw system calls, no liburing is needed. If the
+ * kernel does not support io_uring, uring_init() fails and callers keep using
+ * the socket path in send.c.
+ *
+ * @note This file is part of the client core module.
+ */
+#ifndef URING_H
+#define URING_H
+
+#include <pthread.h>
+#include <linux/io_uring.h>
+
+#include "send.h"
+#include "pipeline.h"
+
+#define URING_ENTRIES 128
+#define URING_CONNECT_ENTRIES 32
+#define URING_RECV_BUFFERS 16
+#define URING_RECV_BUFFER_SIZE 4096
+
+/**
+ * @brief Struct holding an io_uring instance and its buffers
+ *
+ * A uring may be shared between threads, requests are serialized by the lock.
+ * Batched connects go through a second, smaller ring with a lock of its own,
+ * so a server that is slow to accept never holds up pipelined requests.
+ */
+typedef struct uring
+{
+    int fd;
+    pthread_mutex_t lock;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_pending; /**< Entries prepared but not yet submitted */
+    struct io_uring_sqe *sqes;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Mappings, kept for uring_destroy() */
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+
+    /* Request arena, registered as a fixed buffer */
+    char *arena;
+    size_t arena_size;
+    size_t slots;
+    size_t slot_size;
+    int registered; /**< Arena is registered, WRITE_FIXED can be used */
+
+    /* Response buffers, provided to the kernel for multishot receive */
+    struct io_uring_buf_ring *buf_ring;
+    char *recv_buffers;
+    size_t buf_ring_size;
+    unsigned short buf_tail;
+    int multishot; /**< Provided buffer ring and multishot receive are available */
+    int ext_arg;   /**< Waits can be bounded by a timeout */
+
+    /* Responses are reassembled here, grows with the size of a batch */
+    char *responses;
+    size_t responses_capacity;
+
+    /* Ring for batched connects, NULL if it could not be set up */
+    struct uring *connects;
+    unsigned connect_gen; /**< Batch number, tells stale connect completions apart */
+} uring_t;
+
+/**
+ * @brief Sets up an io_uring instance and its request and response arenas
+ *
+ * @param u Pointer to the uring to initialize
+ * @param slots Number of request slots, usually the pipeline window
+ * @param slot_size Size of each request slot in bytes, including header room
+ *
+ * @return Returns 0 on success, -1 if io_uring is not available
+ */
+int uring_init(uring_t *u, size_t slots, size_t slot_size);
+
+/**
+ * @brief Returns where the body of a request slot should be serialized
+ *
+ * Bodies written here are sent straight from the registered arena, the
+ * header is placed in the room reserved in front of them.
+ *
+ * @param u Pointer to the uring
+ * @param slot The slot index
+ * @param capacity Set to the number of bytes available for the body
+ *
+ * @return Returns the body buffer, NULL if the slot does not exist
+ */
+char *uring_body(uring_t *u, size_t slot, size_t *capacity);
+
+/**
+ * @brief Connects several sockets to the server with one batch of connects
+ *
+ * Used by the pool to reconnect all of its dead connections at once. The
+ * connects run on the connect ring, pipelined requests on the main ring are
+ * not blocked while they wait. A socket is only returned once its connect has
+ * completed, if the ring fails the connects still in flight are cancelled and
+ * their sockets closed.
+ *
+ * @param u Pointer to the uring
+ * @param endpoint The server, TCP or Unix domain socket
+ * @param socks Filled with the connected sockets, -1 for failed ones
+ * @param count Number of sockets to connect, at most URING_CONNECT_ENTRIES / 2
+ * @param timeout_ms Time allowed for each connect, 0 for none
+ *
+ * @return Returns the number of connected sockets, -1 if there is no connect ring
+ */
+int uring_connect(uring_t *u, const endpoint_t *endpoint, int socks[], size_t count,
+                  long timeout_ms);
+
+/**
+ * @brief Sends POST requests pipelined on one connection through io_uring
+ *
+ * Same contract as http_POST_pipelined(). Each window of sends is submitted
+ * as one linked chain, so requests leave in order. Response deadlines need a
+ * kernel with IORING_FEAT_EXT_ARG (5.11), older kernels wait without one.
+ *
+ * @param u Pointer to the uring
+ * @param sock The socket descriptor for the connection to the server
+ * @param tpl The pre-rendered POST header
+ * @param reqs The requests to send, in order
+ * @param count Number of requests
+ * @param window Maximum number of requests in flight, at most PIPELINE_MAX_WINDOW
+ * @param timeout_ms Time allowed for each response, 0 for none
+ *
+ * @return Returns 1 if the connection can be reused, 0 if it must be closed,
+ *         -1 on invalid arguments
+ */
+int uring_POST_pipelined(uring_t *u, int sock, const post_template_t *tpl,
+                         pipeline_request_t reqs[], size_t count, size_t window,
+                         long timeout_ms);
+
+/**
+ * @brief Unmaps the rings and arenas and closes the io_uring instance
+ *
+ * @param u Pointer to the uring
+ */
+void uring_destroy(uring_t *u);
+
+#endif
@@ -34,7 +34,13 @@ char *base64_enc(char *data, size_t input_length, size_t *output_length)
     {
         return NULL;
     }
+    base64_enc_buf(data, input_length, encoded);
+    return encoded;
+}
 
+size_t base64_enc_buf(const char *data, size_t input_length, char *encoded)
+{
+    size_t output_length = base64_out_len(input_length);
     // Divide the input into 3 byte blocks
     for (int i = 0; i < input_length; i += 3)
     {
@@ -53,6 +59,39 @@ char *base64_enc(char *data, size_t input_length, size_t *output_length)
     }
 
     // Null-terminate the encoded string
-    encoded[*output_length] = '\0';
-    return encoded;
-}
\ No newline at end of file
+    encoded[output_length] = '\0';
+    return output_length;
+}
+
+int base64_dec(const char *data, size_t input_length, unsigned char *out, size_t out_size)
+{
+    if (input_length % 4 != 0)
+        return -1;
+    size_t padding = 0;
+    if (input_length > 0 && data[input_length - 1] == '=')
+        padding++;
+    if (input_length > 1 && data[input_length - 2] == '=')
+        padding++;
+    size_t output_length = input_length / 4 * 3 - padding;
+    if (output_length > out_size)
+        return -1;
+
+    for (size_t i = 0, o = 0; i < input_length; i += 4)
+    {
+        // Decode 4 characters into a 24 bit number, padding counts as zero
+        unsigned int b24 = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            char c = base64_dectable[(unsigned char)data[i + j]];
+            if (data[i + j] == '=' && i + 4 == input_length && j >= 4 - (int)padding)
+                c = 0;
+            else if (c < 0)
+                return -1;
+            b24 = (b24 << 6) | (unsigned int)c;
+        }
+        // Split it into up to 3 bytes
+        for (int j = 0; j < 3 && o < output_length; j++)
+            out[o++] = (b24 >> (16 - 8 * j)) & 0xFF;
+    }
+    return (int)output_length;
+}
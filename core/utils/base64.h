@@ -8,5 +8,9 @@ extern char base64_dectable[256];
 void base64_build_dectable();
 size_t base64_out_len(size_t in_len);
 char *base64_enc(char *data, size_t input_length, size_t *output_length);
+/* Encodes into encoded, which needs base64_out_len(input_length) + 1 bytes. Returns the length. */
+size_t base64_enc_buf(const char *data, size_t input_length, char *encoded);
+/* Decodes into out, returns the number of bytes or -1. Needs base64_build_dectable() first. */
+int base64_dec(const char *data, size_t input_length, unsigned char *out, size_t out_size);
 
 #endif
\ No newline at end of file
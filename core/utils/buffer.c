@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+
+int buffer_reserve(char **buffer, size_t *capacity, size_t needed)
+{
+    if (needed <= *capacity && *buffer != NULL)
+        return 0;
+    if (needed > BUFFER_MAX_CAPACITY)
+    {
+        fprintf(stderr, "Buffer of %zu bytes exceeds the maximum of %d\n", needed, BUFFER_MAX_CAPACITY);
+        return -1;
+    }
+    size_t new_capacity = *capacity > BUFFER_MIN_CAPACITY ? *capacity : BUFFER_MIN_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    if (new_capacity > BUFFER_MAX_CAPACITY)
+        new_capacity = BUFFER_MAX_CAPACITY;
+    char *grown = (char *)realloc(*buffer, new_capacity);
+    if (grown == NULL)
+    {
+        fprintf(stderr, "Could not grow buffer to %zu bytes\n", new_capacity);
+        return -1;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file buffer.h
+ * @brief Geometrically growing heap buffers
+ *
+ * Used for request and response buffers whose size depends on the number of
+ * data points in a batch, so that payloads are not capped by a fixed size.
+ */
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>
+
+#define BUFFER_MIN_CAPACITY 4096
+#define BUFFER_MAX_CAPACITY (64 * 1024 * 1024)
+
+/**
+ * @brief Grows a heap buffer until it can hold at least needed bytes
+ *
+ * The capacity is doubled until it is large enough, so a buffer filled one
+ * write at a time is copied O(log n) times. The contents are kept.
+ *
+ * @param buffer Pointer to the buffer, may point to NULL for a new buffer
+ * @param capacity Pointer to the current capacity, updated on success
+ * @param needed Number of bytes the buffer must hold
+ *
+ * @return Returns 0 on success, -1 if the allocation failed or needed is
+ *         larger than BUFFER_MAX_CAPACITY. The buffer is unchanged on failure.
+ */
+int buffer_reserve(char **buffer, size_t *capacity, size_t needed);
+
+#endif
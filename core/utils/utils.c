@@ -1,4 +1,9 @@
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
 #include "utils.h"
+#include "../crypto/curve/curve.h"
 
 int relic_init()
 {
@@ -7,7 +12,7 @@ int relic_init()
         core_clean();
         return RLC_ERR;
     }
-    if (pc_param_set_any() != RLC_OK)
+    if (curve_set() != RLC_OK)
     {
         core_clean();
         return RLC_ERR;
@@ -21,6 +26,18 @@ int relic_cleanup()
     return RLC_OK;
 }
 
+int relic_thread_init(int low_priority)
+{
+    if (low_priority)
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+    return relic_init();
+}
+
+void relic_thread_cleanup()
+{
+    core_clean();
+}
+
 int convert_to_g1(g1_t new_sig, char *decoded_sig, dig_t len)
 {
     // Initialize the signature
@@ -38,8 +55,28 @@ int convert_to_g1(g1_t new_sig, char *decoded_sig, dig_t len)
     return RLC_OK;
 }
 
+// Bring all points to affine form with one shared inversion (Montgomery's trick),
+// g1_size_bin and g1_write_bin would otherwise invert once per point
+int normalize_signatures(message_t *msg, int num_data_points)
+{
+    if (num_data_points <= 0)
+        return -1;
+    RLC_TRY
+    {
+        g1_norm_sim(msg->sigs, (const g1_t *)msg->sigs, num_data_points);
+    }
+    RLC_CATCH_ANY
+    {
+        fprintf(stderr, "Failed to normalize signatures\n");
+        return -1;
+    }
+    return 0;
+}
+
 int encode_signatures(message_t *msg, unsigned char *master[], char *master_decoded[], int num_data_points)
 {
+    if (normalize_signatures(msg, num_data_points) != 0)
+        return -1;
     int sig_len = g1_size_bin(msg->sigs[0], 1);
     /* Convert the signature and encode signature */
     for (size_t i = 0; i < num_data_points; i++)
@@ -65,3 +102,28 @@ int encode_signatures(message_t *msg, unsigned char *master[], char *master_deco
     }
     return 0;
 }
+
+int write_signatures(message_t *msg, unsigned char *master[], int num_data_points)
+{
+    if (normalize_signatures(msg, num_data_points) != 0)
+        return -1;
+    int sig_len = g1_size_bin(msg->sigs[0], 1);
+    if (sig_len > MAX_SIGNATURE_LENGTH)
+    {
+        fprintf(stderr, "Signatures of %d bytes do not fit the buffers\n", sig_len);
+        return -1;
+    }
+    for (size_t i = 0; i < num_data_points; i++)
+        g1_write_bin(master[i], sig_len, msg->sigs[i], 1);
+    return sig_len;
+}
+
+int encode_signatures_into(message_t *msg, unsigned char *master[], char *master_decoded[], int num_data_points)
+{
+    int sig_len = write_signatures(msg, master, num_data_points);
+    if (sig_len < 0)
+        return -1;
+    for (size_t i = 0; i < num_data_points; i++)
+        base64_enc_buf((char *)master[i], sig_len, master_decoded[i]);
+    return 0;
+}
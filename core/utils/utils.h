@@ -14,7 +14,8 @@
  * @brief Initializes the RELIC library core and sets pairing parameters.
  *
  * This function initializes the core components of the RELIC library and sets
- * the pairing parameters to any available configuration. If the core
+ * the pairing parameters to the curve chosen with curve_select(), or to any
+ * available configuration if none was chosen. If the core
  * initialization fails or if setting the pairing parameters fails, the
  * function cleans up the core components and returns an error code.
  *
@@ -34,6 +35,25 @@ int relic_init();
  */
 int relic_cleanup();
 
+/**
+ * @brief Sets up RELIC in a thread other than the main one.
+ *
+ * Every thread that calls RELIC needs its own core context with the curve
+ * relic_init() set, so RELIC has to be built with MULTI=PTHREAD; otherwise
+ * all threads share one context and corrupt each other's state. Background
+ * threads can lower their priority so they only run when the send path
+ * leaves the CPU idle.
+ *
+ * @param low_priority Nonzero to run the calling thread at nice 19.
+ * @return RLC_OK on success, RLC_ERR otherwise with the context cleaned up.
+ */
+int relic_thread_init(int low_priority);
+
+/**
+ * @brief Frees the RELIC context of a thread set up with relic_thread_init().
+ */
+void relic_thread_cleanup();
+
 /**
  * @brief Converts a decoded signature into a g1_t type.
  * @note Rememeber to that the caller is responsible for freeing g1_t
@@ -77,6 +97,9 @@ char *base64_encode(const char *input, int length);
 /**
  * @brief Encodes digital signatures into base64 format.
  *
+ * The signatures are normalized together first, with a single field
+ * inversion for the whole message, and are left in affine form.
+ *
  * @param msg Pointer to the message structure containing the signatures
  * @param master Array of pointers to store binary signatures
  * @param master_decoded Array of pointers to store base64 encoded signatures
@@ -86,4 +109,45 @@ char *base64_encode(const char *input, int length);
  */
 int encode_signatures(message_t *msg, unsigned char *master[], char *master_decoded[], int num_data_points);
 
+/**
+ * @brief Brings the signatures to affine form with one shared inversion
+ *
+ * Serializing a normalized point does not invert again, see json_add_g1().
+ *
+ * @param msg Pointer to the message structure containing the signatures
+ * @param num_data_points Number of signatures to process
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int normalize_signatures(message_t *msg, int num_data_points);
+
+/**
+ * @brief Writes the compressed signatures into caller-provided buffers
+ *
+ * The binary half of encode_signatures_into(), for encodings that carry raw
+ * signatures. master[i] must hold MAX_SIGNATURE_LENGTH bytes.
+ *
+ * @param msg Pointer to the message structure containing the signatures
+ * @param master Buffers for the binary signatures
+ * @param num_data_points Number of signatures to process
+ *
+ * @return The length of each signature, -1 on failure.
+ */
+int write_signatures(message_t *msg, unsigned char *master[], int num_data_points);
+
+/**
+ * @brief Encodes digital signatures into caller-provided buffers
+ *
+ * Same as encode_signatures() without allocating: master[i] must hold
+ * MAX_SIGNATURE_LENGTH bytes and master_decoded[i] MAX_SIGNATURE_B64_LENGTH.
+ *
+ * @param msg Pointer to the message structure containing the signatures
+ * @param master Buffers for the binary signatures
+ * @param master_decoded Buffers for the base64 encoded signatures
+ * @param num_data_points Number of signatures to process
+ *
+ * @return 0 on success, -1 on encoding failure.
+ */
+int encode_signatures_into(message_t *msg, unsigned char *master[], char *master_decoded[], int num_data_points);
+
 #endif
\ No newline at end of file
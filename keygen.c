@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "relic/relic.h"
+/* Internal includes */
+#include "core/crypto/keystore/keystore.h"
+#include "core/crypto/curve/curve.h"
+#include "core/message/message.h"
+
+#define KEYGEN_DEFAULT_DEVICES 1000
+
+/* Fills a keystore with key pairs for devices DEVICE_ID, DEVICE_ID + 1, ... */
+int main(int argc, char *argv[])
+{
+  const char *path = KEYSTORE_DEFAULT_PATH;
+  long long devices = KEYGEN_DEFAULT_DEVICES;
+  unsigned long long first_id = strtoull(DEVICE_ID, NULL, 10);
+  int threads = 0;
+  const char *curve_name = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:n:f:t:c:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'o':
+      path = optarg;
+      break;
+    case 'n':
+      devices = atoll(optarg);
+      break;
+    case 'f':
+      first_id = strtoull(optarg, NULL, 10);
+      break;
+    case 't':
+      threads = atoi(optarg);
+      break;
+    case 'c':
+      curve_name = optarg;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-o keystore] [-n devices] [-f first device id] [-t threads] [-c curve]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (devices < 1 || devices > KEYSTORE_MAX_DEVICES)
+  {
+    fprintf(stderr, "Number of devices must be between 1 and %d\n", KEYSTORE_MAX_DEVICES);
+    return -1;
+  }
+  if (threads < 0)
+  {
+    fprintf(stderr, "Threads must not be negative\n");
+    return -1;
+  }
+  if (curve_name != NULL)
+  {
+    const curve_info_t *curve = curve_find(curve_name);
+    if (curve == NULL)
+    {
+      fprintf(stderr, "Unknown curve %s\n", curve_name);
+      curve_print_list(stderr);
+      return -1;
+    }
+    curve_select(curve);
+  }
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  if (keystore_create(path, first_id, (size_t)devices, (size_t)threads) != 0)
+    return -1;
+  gettimeofday(&end, NULL);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("Generated %lld key pairs into %s in %.2f s\n", devices, path, elapsed);
+  return 0;
+}
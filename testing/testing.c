@@ -1,5 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "testing.h"
 
+#define TIMER_MAX_FILES 16
+
+/* Result files stay open, opening one per sample would allocate in the measured loop */
+static struct
+{
+    const char *name;
+    FILE *file;
+} timer_files[TIMER_MAX_FILES];
+
+#ifdef TEST_MODE
+// Heap allocations made by this thread
+static __thread size_t allocations;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+// Count every allocation on its way to the C library
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+size_t alloc_count()
+{
+    return allocations;
+}
+#endif
+
+static FILE *timer_file(const char *test_name)
+{
+    int i = 0;
+    for (; i < TIMER_MAX_FILES && timer_files[i].name != NULL; i++)
+    {
+        if (strcmp(timer_files[i].name, test_name) == 0)
+            return timer_files[i].file;
+    }
+    if (i == TIMER_MAX_FILES)
+        return NULL;
+    char filename[256];
+    snprintf(filename, sizeof(filename), "data/%s.csv", test_name);
+    FILE *file = fopen(filename, "a");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open file %s\n", filename);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "Execution Time(ms)\n");
+    }
+    // Timer names are string literals, so the pointer stays valid
+    timer_files[i].name = test_name;
+    timer_files[i].file = file;
+    return file;
+}
+
 // Start timing and return the start time
 struct timeval timer_start()
 {
@@ -17,19 +91,8 @@ void timer_end(struct timeval start, const char *test_name)
     double elapsed = (end.tv_sec - start.tv_sec) +
                      (end.tv_usec - start.tv_usec) / 1000000.0;
     double elapsed_ms = elapsed * 1000; // Convert to milliseconds
-    char filename[sizeof(test_name) + 24];
-    snprintf(filename, sizeof(filename), "data/%s.csv", test_name);
-    FILE *file = fopen(filename, "a");
+    FILE *file = timer_file(test_name);
     if (file == NULL)
-    {
-        fprintf(stderr, "Failed to open file %s\n", filename);
         return;
-    }
-    fseek(file, 0, SEEK_END);
-    if (ftell(file) == 0)
-    {
-        fprintf(file, "Execution Time(ms)\n");
-    }
     fprintf(file, "%f\n", elapsed_ms);
-    fclose(file);
 }
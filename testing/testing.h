@@ -8,5 +8,9 @@
 
 struct timeval timer_start();
 void timer_end(struct timeval start, const char *test_name);
+#ifdef TEST_MODE
+/* Number of malloc, calloc and realloc calls made by the calling thread so far */
+size_t alloc_count();
+#endif
 
 #endif
\ No newline at end of file